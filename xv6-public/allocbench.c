@@ -0,0 +1,97 @@
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "fcntl.h"
+#include "fs.h"
+
+// Cost of block allocation on an empty disk and on one that is
+// 90% full, with the free space left scattered between files.
+// nmeta is the count of map blocks the test file needed; with
+// extents, 0 means the file is one run on the disk.
+
+#define FILLBLK  32   // blocks in each filler file
+#define MAXFILL  190  // fewer than the inodes on the disk
+#define TESTBLK  256  // blocks in the timed file
+
+char buf[BSIZE];
+
+void
+fname(char *path, int i)
+{
+  strcpy(path, "fillxxx");
+  path[4] = '0' + i / 100;
+  path[5] = '0' + i / 10 % 10;
+  path[6] = '0' + i % 10;
+}
+
+void
+wfile(char *path, int nblk)
+{
+  int fd, i;
+
+  if((fd = open(path, O_CREATE | O_RDWR)) < 0){
+    printf(1, "allocbench: cannot create %s\n", path);
+    exit();
+  }
+  for(i = 0; i < nblk; i++)
+    if(write(fd, buf, sizeof(buf)) != sizeof(buf)){
+      printf(1, "allocbench: write to %s failed\n", path);
+      exit();
+    }
+  close(fd);
+}
+
+// write and then delete a file of nblk blocks, timed.
+void
+timed(char *what, int nblk)
+{
+  uint hit0, miss0, hit, miss;
+  struct stat st;
+  int t, tu;
+
+  bstat(&hit0, &miss0);
+  t = uptime();
+  wfile("testfile", nblk);
+  t = uptime() - t;
+  bstat(&hit, &miss);
+  stat("testfile", &st);
+  tu = uptime();
+  unlink("testfile");
+  tu = uptime() - tu;
+  printf(1, "%s: %d free, %d blocks written in %d ticks, "
+         "%d lookups, nmeta %d, unlink %d ticks\n", what, freeblocks(),
+         nblk, t, (hit + miss) - (hit0 + miss0), st.nmeta, tu);
+}
+
+int
+main(int argc, char *argv[])
+{
+  char path[8];
+  int free0, nfill, n, i;
+
+  free0 = freeblocks();
+  n = free0 / 4 < TESTBLK ? free0 / 4 : TESTBLK;
+  printf(1, "allocbench: %d free blocks of %d bytes\n", free0, BSIZE);
+  timed("empty", n);
+
+  // fill the disk, leaving a little for directories and the log,
+  // then delete every fourth file until 10% is free again.
+  nfill = 0;
+  while(nfill < MAXFILL && freeblocks() > free0 / 20 + 2 * FILLBLK){
+    fname(path, nfill++);
+    wfile(path, FILLBLK);
+  }
+  for(i = 0; i < nfill && freeblocks() < free0 / 10; i += 4){
+    fname(path, i);
+    unlink(path);
+  }
+  n = freeblocks() / 2 < n ? freeblocks() / 2 : n;
+  timed("90% full", n);
+
+  for(i = 0; i < nfill; i++){
+    fname(path, i);
+    unlink(path);
+  }
+  printf(1, "allocbench done: %d free\n", freeblocks());
+  exit();
+}
@@ -0,0 +1,64 @@
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "fcntl.h"
+
+#define NPASS 5
+
+char buf[512];
+
+void
+mkfile(char *path, int size)
+{
+  int fd, n;
+
+  if((fd = open(path, O_CREATE | O_RDWR)) < 0){
+    printf(1, "bcachebench: cannot create %s\n", path);
+    exit();
+  }
+  memset(buf, 'b', sizeof(buf));
+  for(n = 0; n < size; n += sizeof(buf))
+    if(write(fd, buf, sizeof(buf)) != sizeof(buf)){
+      printf(1, "bcachebench: write failed\n");
+      exit();
+    }
+  close(fd);
+}
+
+// read a size-byte file NPASS times, with the cache's hit rate
+// for each pass.
+void
+reread(int size)
+{
+  uint hit0, miss0, hit, miss;
+  int fd, i, n, start;
+
+  mkfile("bcachefile", size);
+  for(i = 0; i < NPASS; i++){
+    bstat(&hit0, &miss0);
+    start = uptime();
+    if((fd = open("bcachefile", O_RDONLY)) < 0)
+      exit();
+    while((n = read(fd, buf, sizeof(buf))) > 0)
+      ;
+    close(fd);
+    bstat(&hit, &miss);
+    hit -= hit0;
+    miss -= miss0;
+    printf(1, "%d KB pass %d: %d ticks, %d hits, %d misses, %d%% hit\n",
+           size / 1024, i, uptime() - start, hit, miss,
+           hit + miss ? hit * 100 / (hit + miss) : 0);
+  }
+  unlink("bcachefile");
+}
+
+int
+main(int argc, char *argv[])
+{
+  printf(1, "bcachebench starting\n");
+  reread(8*1024);
+  reread(64*1024);
+  reread(512*1024);
+  printf(1, "bcachebench done\n");
+  exit();
+}
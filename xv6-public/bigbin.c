@@ -0,0 +1,25 @@
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+
+// A large program for execbench: 256KB of initialized data that
+// exec() used to read in whole before main() ran.
+#define BIGSIZE (256*1024)
+
+char big[BIGSIZE] = { 1 };
+
+int
+main(int argc, char *argv[])
+{
+  int i, sum;
+
+  // "touch" reads every page, as if exec had loaded them all.
+  if(argc > 1 && strcmp(argv[1], "touch") == 0){
+    sum = 0;
+    for(i = 0; i < BIGSIZE; i += 4096)
+      sum += big[i];
+    if(sum == 0)
+      printf(2, "bigbin: bad data\n");
+  }
+  exit();
+}
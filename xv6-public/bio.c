@@ -21,38 +21,238 @@
 #include "types.h"
 #include "defs.h"
 #include "param.h"
+#include "memlayout.h"
+#include "mmu.h"
 #include "spinlock.h"
 #include "sleeplock.h"
 #include "fs.h"
 #include "buf.h"
 
-struct {
+#define NBUCKET 1021  // hash buckets, a prime
+
+// Buffers are allocated from a slab cache as they are first
+// needed, up to bcache.max of them, which binit() sets to what
+// 1/BCACHEMEM of physical memory holds.  After that bget()
+// recycles idle buffers, and when every buffer is referenced or
+// pinned by the log it waits for brelse() to free one.
+//
+// Buffers are hashed by (dev, blockno) into NBUCKET buckets, each
+// with its own lock and its own LRU list, so that lookups and
+// releases of different blocks do not contend.  Buffers that are
+// neither referenced nor dirty are also on one idle list, least
+// recently used last, under bcache.idlelock, which is taken
+// after a bucket lock.  A miss takes bcache.lock, which
+// serializes the recycling of buffers, and steals the buffer at
+// the end of the idle list out of its bucket.  Only a miss holds
+// two bucket locks at once, so they cannot deadlock.
+struct bucket {
   struct spinlock lock;
-  struct buf buf[NBUF];
+  // List of the bucket's buffers, through prev/next,
+  // from most (mru) to least (lru) recently used.
+  struct buf *mru;
+  struct buf *lru;
+  uint nhit;   // lookups that found the block
+  uint nmiss;  // lookups that did not
+};
 
-  // Linked list of all buffers, through prev/next.
-  // head.next is most recently used.
-  struct buf head;
+struct {
+  struct spinlock lock;  // recycling; protects nbuf and nwait
+  struct spinlock idlelock;  // the idle list
+  // Idle buffers, through lprev/lnext, from most (mru) to least
+  // (lru) recently used.
+  struct buf *mru;
+  struct buf *lru;
+  struct kmem_cache *cache;
+  int nbuf;   // buffers in the buckets
+  int max;    // most buffers to allocate
+  int nwait;  // processes waiting for an idle buffer
+  uchar *data;  // rest of the page bdata() is cutting up, or 0
+  struct bucket bucket[NBUCKET];
 } bcache;
 
+static void bdone(struct buf*);
+
+static void
+bufctor(void *v)
+{
+  struct buf *b = v;
+
+  initsleeplock(&b->lock, "buffer");
+  b->idle = 0;
+}
+
 void
 binit(void)
 {
-  struct buf *b;
+  struct bucket *bk;
 
   initlock(&bcache.lock, "bcache");
+  initlock(&bcache.idlelock, "bcache.idle");
+  bcache.cache = kmem_cache_create("buf", sizeof(struct buf), bufctor);
+  bcache.max = PHYSTOP / BCACHEMEM / (sizeof(struct buf) + BSIZE);
+  cprintf("bcache: up to %d buffers\n", bcache.max);
 
 //PAGEBREAK!
-  // Create linked list of buffers
-  bcache.head.prev = &bcache.head;
-  bcache.head.next = &bcache.head;
-  for(b = bcache.buf; b < bcache.buf+NBUF; b++){
-    b->next = bcache.head.next;
-    b->prev = &bcache.head;
-    initsleeplock(&b->lock, "buffer");
-    bcache.head.next->prev = b;
-    bcache.head.next = b;
+  for(bk = bcache.bucket; bk < &bcache.bucket[NBUCKET]; bk++)
+    initlock(&bk->lock, "bcache.bucket");
+}
+
+static struct bucket*
+bhash(uint dev, uint blockno)
+{
+  return &bcache.bucket[(dev * 31 + blockno) % NBUCKET];
+}
+
+// Put b at the MRU end of bk.  Caller holds bk->lock.
+static void
+blink(struct bucket *bk, struct buf *b)
+{
+  b->prev = 0;
+  b->next = bk->mru;
+  if(bk->mru)
+    bk->mru->prev = b;
+  else
+    bk->lru = b;
+  bk->mru = b;
+}
+
+static void
+bunlink(struct bucket *bk, struct buf *b)
+{
+  if(b->prev)
+    b->prev->next = b->next;
+  else
+    bk->mru = b->next;
+  if(b->next)
+    b->next->prev = b->prev;
+  else
+    bk->lru = b->prev;
+}
+
+// Find block blockno of dev in bk.  Caller holds bk->lock.
+static struct buf*
+bfind(struct bucket *bk, uint dev, uint blockno)
+{
+  struct buf *b;
+
+  for(b = bk->mru; b; b = b->next)
+    if(b->dev == dev && b->blockno == blockno)
+      return b;
+  return 0;
+}
+
+// Put b at the MRU end of the idle list.  Caller holds
+// bcache.idlelock.
+static void
+bidle(struct buf *b)
+{
+  b->lprev = 0;
+  b->lnext = bcache.mru;
+  if(bcache.mru)
+    bcache.mru->lprev = b;
+  else
+    bcache.lru = b;
+  bcache.mru = b;
+  b->idle = 1;
+}
+
+static void
+bunidle(struct buf *b)
+{
+  if(b->lprev)
+    b->lprev->lnext = b->lnext;
+  else
+    bcache.mru = b->lnext;
+  if(b->lnext)
+    b->lnext->lprev = b->lprev;
+  else
+    bcache.lru = b->lprev;
+  b->idle = 0;
+}
+
+// Take a reference to b.  Caller holds the lock of b's bucket.
+static void
+bhold(struct buf *b)
+{
+  if(b->refcnt++ == 0 && b->idle){
+    acquire(&bcache.idlelock);
+    bunidle(b);
+    release(&bcache.idlelock);
+  }
+}
+
+// Take the least recently used idle buffer out of its bucket.
+// "Idle" means neither referenced nor dirty; B_DIRTY and not
+// locked means log.c hasn't yet committed the changes to the
+// buffer.  Caller holds bcache.lock and bk->lock; bk may be the
+// victim's own bucket.  A victim's bucket cannot change while
+// bcache.lock is held, but a hit may take it off the idle list
+// before its bucket lock is ours, and then we try the next.
+static struct buf*
+bsteal(struct bucket *bk)
+{
+  struct bucket *v;
+  struct buf *b;
+
+  for(;;){
+    acquire(&bcache.idlelock);
+    if((b = bcache.lru) == 0){
+      release(&bcache.idlelock);
+      return 0;
+    }
+    release(&bcache.idlelock);
+    v = bhash(b->dev, b->blockno);
+    if(v != bk)
+      acquire(&v->lock);
+    acquire(&bcache.idlelock);
+    if(b->idle){
+      bunidle(b);
+      release(&bcache.idlelock);
+      bunlink(v, b);
+      if(v != bk)
+        release(&v->lock);
+      return b;
+    }
+    release(&bcache.idlelock);
+    if(v != bk)
+      release(&v->lock);
+  }
+}
+
+// Data for a fresh buffer, cut from whole pages so that blocks
+// of any size up to PGSIZE pack without waste.  Buffers are never
+// freed, and neither is their data.  Caller holds bcache.lock.
+static uchar*
+bdata(void)
+{
+  uchar *d;
+
+  if(bcache.data == 0 && (bcache.data = (uchar*)kalloc()) == 0)
+    return 0;
+  d = bcache.data;
+  bcache.data += BSIZE;
+  if((uint)bcache.data % PGSIZE == 0)
+    bcache.data = 0;
+  return d;
+}
+
+// A buffer for a new block: a fresh one while the cache is
+// small, else an idle one, or 0.  Caller holds bcache.lock and
+// bk->lock.
+static struct buf*
+bnew(struct bucket *bk)
+{
+  struct buf *b;
+
+  if(bcache.nbuf < bcache.max &&
+     (b = kmem_cache_alloc(bcache.cache)) != 0){
+    if((b->data = bdata()) != 0){
+      bcache.nbuf++;
+      return b;
+    }
+    kmem_cache_free(bcache.cache, b);
   }
+  return bsteal(bk);
 }
 
 // Look through buffer cache for block on device dev.
@@ -61,35 +261,112 @@ binit(void)
 static struct buf*
 bget(uint dev, uint blockno)
 {
+  struct bucket *bk;
   struct buf *b;
 
-  acquire(&bcache.lock);
+  bk = bhash(dev, blockno);
+  acquire(&bk->lock);
 
   // Is the block already cached?
-  for(b = bcache.head.next; b != &bcache.head; b = b->next){
-    if(b->dev == dev && b->blockno == blockno){
-      b->refcnt++;
-      release(&bcache.lock);
-      acquiresleep(&b->lock);
-      return b;
-    }
+  if((b = bfind(bk, dev, blockno)) != 0){
+    bhold(b);
+    bk->nhit++;
+    release(&bk->lock);
+    acquiresleep(&b->lock);
+    return b;
   }
+  bk->nmiss++;
+  release(&bk->lock);
 
-  // Not cached; recycle some unused buffer and clean buffer
-  // "clean" because B_DIRTY and not locked means log.c
-  // hasn't yet committed the changes to the buffer.
-  for(b = bcache.head.prev; b != &bcache.head; b = b->prev){
-    if(b->refcnt == 0 && (b->flags & B_DIRTY) == 0) {
-      b->dev = dev;
-      b->blockno = blockno;
-      b->flags = 0;
-      b->refcnt = 1;
+  // Not cached.  Look again under bcache.lock, since another
+  // process may have brought the block in meanwhile.
+  acquire(&bcache.lock);
+  for(;;){
+    acquire(&bk->lock);
+    if((b = bfind(bk, dev, blockno)) != 0){
+      bhold(b);
+      release(&bk->lock);
       release(&bcache.lock);
       acquiresleep(&b->lock);
       return b;
     }
+
+    // Count ourselves as waiting before looking for a buffer, so
+    // that a brelse() that races with the search will wake us.
+    bcache.nwait++;
+    if((b = bnew(bk)) != 0)
+      break;
+    // Every buffer is busy: wait for brelse().
+    release(&bk->lock);
+    sleep(&bcache, &bcache.lock);
+    bcache.nwait--;
+  }
+  bcache.nwait--;
+  b->dev = dev;
+  b->blockno = blockno;
+  b->flags = 0;
+  b->refcnt = 1;
+  blink(bk, b);
+  release(&bk->lock);
+  release(&bcache.lock);
+  acquiresleep(&b->lock);
+  return b;
+}
+
+// Start reading block blockno of dev into the cache, unless it
+// is there already, without waiting for the disk: for read-ahead.
+// The buffer stays locked until the read finishes and bdone()
+// runs.
+// Gives up rather than wait for a buffer.
+void
+bprefetch(uint dev, uint blockno)
+{
+  struct bucket *bk;
+  struct buf *b;
+
+  bk = bhash(dev, blockno);
+  acquire(&bk->lock);
+  b = bfind(bk, dev, blockno);
+  release(&bk->lock);
+  if(b)
+    return;
+
+  acquire(&bcache.lock);
+  acquire(&bk->lock);
+  if(bfind(bk, dev, blockno) == 0 && (b = bnew(bk)) != 0){
+    b->dev = dev;
+    b->blockno = blockno;
+    b->flags = 0;
+    b->refcnt = 1;
+    blink(bk, b);
+  }
+  release(&bk->lock);
+  release(&bcache.lock);
+  if(b == 0)
+    return;
+
+  // A bread() of the block may have got the lock first.
+  acquiresleep(&b->lock);
+  if(b->flags & B_VALID){
+    brelse(b);
+    return;
+  }
+  bio_submit(b, bdone);
+}
+
+// Hits and misses of the cache so far, for bstat().
+void
+bstat(uint *hit, uint *miss)
+{
+  struct bucket *bk;
+
+  *hit = *miss = 0;
+  for(bk = bcache.bucket; bk < &bcache.bucket[NBUCKET]; bk++){
+    acquire(&bk->lock);
+    *hit += bk->nhit;
+    *miss += bk->nmiss;
+    release(&bk->lock);
   }
-  panic("bget: no buffers");
 }
 
 // Return a locked buf with the contents of the indicated block.
@@ -116,8 +393,40 @@ bwrite(struct buf *b)
   iderw(b);
 }
 
+// Drop a reference to an unlocked buffer.
+// Move to the head of its bucket's MRU list, and wake anyone
+// waiting for an idle buffer.
+static void
+bput(struct buf *b)
+{
+  struct bucket *bk;
+  int idle;
+
+  bk = bhash(b->dev, b->blockno);
+  acquire(&bk->lock);
+  b->refcnt--;
+  idle = 0;
+  if (b->refcnt == 0) {
+    // no one is waiting for it.
+    bunlink(bk, b);
+    blink(bk, b);
+    if((b->flags & B_DIRTY) == 0){
+      acquire(&bcache.idlelock);
+      bidle(b);
+      release(&bcache.idlelock);
+      idle = 1;
+    }
+  }
+  release(&bk->lock);
+
+  if(idle && bcache.nwait > 0){
+    acquire(&bcache.lock);
+    wakeup(&bcache);
+    release(&bcache.lock);
+  }
+}
+
 // Release a locked buffer.
-// Move to the head of the MRU list.
 void
 brelse(struct buf *b)
 {
@@ -125,21 +434,16 @@ brelse(struct buf *b)
     panic("brelse");
 
   releasesleep(&b->lock);
+  bput(b);
+}
 
-  acquire(&bcache.lock);
-  b->refcnt--;
-  if (b->refcnt == 0) {
-    // no one is waiting for it.
-    b->next->prev = b->prev;
-    b->prev->next = b->next;
-    b->next = bcache.head.next;
-    b->prev = &bcache.head;
-    bcache.head.next->prev = b;
-    bcache.head.next = b;
-  }
-  
-  release(&bcache.lock);
+// Release a buffer whose bprefetch() read has finished.
+// Runs from ideintr(), so not as the process that locked it.
+static void
+bdone(struct buf *b)
+{
+  releasesleep(&b->lock);
+  bput(b);
 }
 //PAGEBREAK!
 // Blank page.
-
@@ -0,0 +1,186 @@
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "fcntl.h"
+#include "fs.h"
+
+// Time the file system phases of usertests and large sequential
+// I/O.  Run it once under "make qemu" (IDE) and once under
+// "make qemu-virtio" to compare the two disks, or with kernels
+// built with different BSIZEs to compare block sizes.
+
+#define NROUND   4
+#define SEQSIZE  (1024*1024)
+
+char buf[4096];
+
+// four processes each write their own file.
+void
+fourfiles(void)
+{
+  char name[3];
+  int i, pi;
+
+  name[0] = 'f';
+  name[2] = 0;
+  for(pi = 0; pi < 4; pi++){
+    if(fork() == 0){
+      name[1] = '0' + pi;
+      int fd = open(name, O_CREATE | O_RDWR);
+      for(i = 0; i < 12; i++)
+        write(fd, buf, 500);
+      close(fd);
+      exit();
+    }
+  }
+  for(pi = 0; pi < 4; pi++)
+    wait();
+  for(pi = 0; pi < 4; pi++){
+    name[1] = '0' + pi;
+    unlink(name);
+  }
+}
+
+// four processes create and delete files in the same directory.
+void
+createdelete(void)
+{
+  char name[3];
+  int i, pi;
+
+  for(pi = 0; pi < 4; pi++){
+    if(fork() == 0){
+      name[0] = 'p' + pi;
+      name[2] = 0;
+      for(i = 0; i < 20; i++){
+        name[1] = '0' + i;
+        close(open(name, O_CREATE | O_RDWR));
+      }
+      for(i = 0; i < 20; i++){
+        name[1] = '0' + i;
+        unlink(name);
+      }
+      exit();
+    }
+  }
+  for(pi = 0; pi < 4; pi++)
+    wait();
+}
+
+// writes of many sizes, as in usertests.
+void
+bigwrite(void)
+{
+  int fd, sz;
+
+  for(sz = 499; sz < 12*512; sz += 471){
+    fd = open("bigwrite", O_CREATE | O_RDWR);
+    write(fd, buf, sz);
+    write(fd, buf, sz);
+    close(fd);
+    unlink("bigwrite");
+  }
+}
+
+void
+bigfile(void)
+{
+  int fd, i;
+
+  fd = open("bigfile", O_CREATE | O_RDWR);
+  for(i = 0; i < 20; i++)
+    write(fd, buf, 600);
+  close(fd);
+  fd = open("bigfile", O_RDONLY);
+  while(read(fd, buf, 300) > 0)
+    ;
+  close(fd);
+  unlink("bigfile");
+}
+
+// many small files in a new directory: metadata, not data.
+void
+smallfiles(void)
+{
+  char name[8];
+  struct stat st;
+  int i, fd;
+
+  mkdir("sdir");
+  strcpy(name, "sdir/a0");
+  for(i = 0; i < 40; i++){
+    name[5] = 'a' + i / 10;
+    name[6] = '0' + i % 10;
+    fd = open(name, O_CREATE | O_RDWR);
+    write(fd, buf, 100);
+    close(fd);
+    stat(name, &st);
+  }
+  for(i = 0; i < 40; i++){
+    name[5] = 'a' + i / 10;
+    name[6] = '0' + i % 10;
+    unlink(name);
+  }
+  unlink("sdir");
+}
+
+void
+phase(char *name, void (*f)(void))
+{
+  int i, t;
+
+  t = uptime();
+  for(i = 0; i < NROUND; i++)
+    f();
+  printf(1, "%s x %d: %d ticks\n", name, NROUND, uptime() - t);
+}
+
+void
+rate(char *what, int n, int t)
+{
+  if(t == 0)
+    t = 1;
+  printf(1, "%s: %d KB in %d ticks, %d KB/s\n", what, n / 1024, t,
+         n / t * 100 / 1024);
+}
+
+// SEQSIZE bytes to a new file, then read back; and a read of
+// bigbin, which only comes from the disk the first time after
+// boot.
+void
+sequential(void)
+{
+  int fd, n, tot, t;
+
+  t = uptime();
+  fd = open("seqfile", O_CREATE | O_RDWR);
+  for(n = 0; n < SEQSIZE; n += sizeof(buf))
+    write(fd, buf, sizeof(buf));
+  close(fd);
+  rate("sequential write", SEQSIZE, uptime() - t);
+  unlink("seqfile");
+
+  if((fd = open("bigbin", O_RDONLY)) < 0)
+    return;
+  t = uptime();
+  tot = 0;
+  while((n = read(fd, buf, sizeof(buf))) > 0)
+    tot += n;
+  close(fd);
+  rate("sequential read of bigbin", tot, uptime() - t);
+}
+
+int
+main(int argc, char *argv[])
+{
+  printf(1, "blkbench starting, block size %d\n", BSIZE);
+  memset(buf, 'z', sizeof(buf));
+  sequential();
+  phase("fourfiles", fourfiles);
+  phase("createdelete", createdelete);
+  phase("bigwrite", bigwrite);
+  phase("bigfile", bigfile);
+  phase("smallfiles", smallfiles);
+  printf(1, "blkbench done\n");
+  exit();
+}
@@ -4,10 +4,15 @@ struct buf {
   uint blockno;
   struct sleeplock lock;
   uint refcnt;
-  struct buf *prev; // LRU cache list
+  struct buf *prev; // LRU list of its hash bucket
   struct buf *next;
+  struct buf *lprev; // idle list, if idle is set
+  struct buf *lnext;
+  int idle;
   struct buf *qnext; // disk queue
-  uchar data[BSIZE];
+  uint qtime;        // ticks when it joined the disk queue
+  void (*done)(struct buf*); // bio_submit() completion, or 0
+  uchar *data;  // BSIZE bytes
 };
 #define B_VALID 0x2  // buffer has been read from disk
 #define B_DIRTY 0x4  // buffer needs to be written to disk
@@ -0,0 +1,96 @@
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "fcntl.h"
+
+#define NFILE  8
+#define NROUND 200
+
+char buf[512];
+int filesize = 2048;
+
+void
+name(char *path, int i)
+{
+  strcpy(path, "catfile0");
+  path[7] = '0' + i;
+}
+
+void
+mkfiles(void)
+{
+  char path[16];
+  int fd, i, n;
+
+  memset(buf, 'x', sizeof(buf));
+  for(i = 0; i < NFILE; i++){
+    name(path, i);
+    if((fd = open(path, O_CREATE | O_RDWR)) < 0){
+      printf(1, "catbench: cannot create %s\n", path);
+      exit();
+    }
+    for(n = 0; n < filesize; n += sizeof(buf))
+      write(fd, buf, sizeof(buf));
+    close(fd);
+  }
+}
+
+// what cat does to file i, NROUND times, minus the output.
+void
+cat(int i)
+{
+  char path[16];
+  int fd, r, n;
+
+  name(path, i);
+  for(r = 0; r < NROUND; r++){
+    if((fd = open(path, O_RDONLY)) < 0){
+      printf(1, "catbench: cannot open %s\n", path);
+      exit();
+    }
+    while((n = read(fd, buf, sizeof(buf))) > 0)
+      ;
+    close(fd);
+  }
+}
+
+// nproc processes each cat their own file at once.
+void
+parallel(int nproc)
+{
+  int i, start;
+
+  start = uptime();
+  for(i = 0; i < nproc; i++){
+    if(fork() == 0){
+      cat(i);
+      exit();
+    }
+  }
+  for(i = 0; i < nproc; i++)
+    wait();
+  printf(1, "%d parallel cats of %d bytes x %d: %d ticks\n",
+         nproc, filesize, NROUND, uptime() - start);
+}
+
+int
+main(int argc, char *argv[])
+{
+  char path[16];
+  int i;
+
+  if(argc > 1)
+    filesize = atoi(argv[1]);
+  printf(1, "catbench starting\n");
+  mkfiles();
+  parallel(1);
+  parallel(2);
+  parallel(4);
+  parallel(8);
+  for(i = 0; i < NFILE; i++){
+    name(path, i);
+    unlink(path);
+  }
+  printf(1, "catbench done\n");
+  exit();
+}
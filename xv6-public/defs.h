@@ -2,6 +2,8 @@ struct buf;
 struct context;
 struct file;
 struct inode;
+struct kmem_cache;
+struct pcidev;
 struct pipe;
 struct proc;
 struct rtcdate;
@@ -9,12 +11,15 @@ struct spinlock;
 struct sleeplock;
 struct stat;
 struct superblock;
+struct vma;
 
 // bio.c
 void            binit(void);
 struct buf*     bread(uint, uint);
 void            brelse(struct buf*);
 void            bwrite(struct buf*);
+void            bstat(uint*, uint*);
+void            bprefetch(uint, uint);
 
 // console.c
 void            consoleinit(void);
@@ -36,10 +41,13 @@ int             filewrite(struct file*, char*, int n);
 
 // fs.c
 void            readsb(int dev, struct superblock *sb);
+void            bsuminit(int dev);
+uint            nfreeblocks(void);
 int             dirlink(struct inode*, char*, uint);
 struct inode*   dirlookup(struct inode*, char*, uint*);
 struct inode*   ialloc(uint, short);
 struct inode*   idup(struct inode*);
+void            icacheinit(void);
 void            iinit(int dev);
 void            ilock(struct inode*);
 void            iput(struct inode*);
@@ -50,6 +58,7 @@ int             namecmp(const char*, const char*);
 struct inode*   namei(char*);
 struct inode*   nameiparent(char*, char*);
 int             readi(struct inode*, char*, uint, uint);
+void            ireadahead(struct inode*, uint, uint);
 void            stati(struct inode*, struct stat*);
 int             writei(struct inode*, char*, uint, uint);
 
@@ -57,6 +66,8 @@ int             writei(struct inode*, char*, uint, uint);
 void            ideinit(void);
 void            ideintr(void);
 void            iderw(struct buf*);
+void            bio_submit(struct buf*, void (*)(struct buf*));
+void            idestat(uint*, uint*, uint*);
 
 // ioapic.c
 void            ioapicenable(int irq, int cpu);
@@ -68,6 +79,11 @@ char*           kalloc(void);
 void            kfree(char*);
 void            kinit1(void*, void*);
 void            kinit2(void*, void*);
+char*           ksuperalloc(void);
+void            ksuperfree(char*);
+int             kfreepages(void);
+void            kref(char*);
+int             krefcount(char*);
 
 // kbd.c
 void            kbdintr(void);
@@ -78,6 +94,7 @@ int             cpunum(void);
 extern volatile uint*    lapic;
 void            lapiceoi(void);
 void            lapicinit(void);
+void            lapicipi(uchar, int);
 void            lapicstartap(uchar, uint);
 void            microdelay(int);
 
@@ -87,10 +104,42 @@ void            log_write(struct buf*);
 void            begin_op();
 void            end_op();
 
+// mem.c
+int             memcmp(const void*, const void*, uint);
+void*           memmove(void*, const void*, uint);
+void*           memset(void*, int, uint);
+
+// mmap.c
+void            mmapinit(void);
+int             mmap(uint, uint, int, int, struct file*, uint);
+int             munmap(uint, uint);
+int             msync(uint, uint);
+int             pagefault(uint, uint);
+int             prefault(uint, uint, int);
+int             pagedonate(uint, int, char**);
+int             pageaccept(uint, char**, int);
+int             vmacopy(struct proc*);
+void            vmaexec(struct proc*, struct vma*, int);
+void            vmafree(struct proc*, pde_t*);
+
 // mp.c
 extern int      ismp;
 void            mpinit(void);
 
+// pcache.c
+void            pcacheinit(void);
+char*           pcachelookup(struct inode*, uint);
+char*           pcacheinsert(struct inode*, uint, char*);
+void            pcacheinval(struct inode*);
+int             pcacheshrink(void);
+void            pcachemap(pde_t*, struct vma*);
+
+// pci.c
+int             pcifind(int, int, int, int, struct pcidev*);
+uint            pciread(struct pcidev*, int);
+void            pciwrite(struct pcidev*, int, uint);
+void            pcienable(struct pcidev*);
+
 // picirq.c
 void            picenable(int);
 void            picinit(void);
@@ -98,8 +147,11 @@ void            picinit(void);
 // pipe.c
 int             pipealloc(struct file**, struct file**);
 void            pipeclose(struct pipe*, int);
+void            pipeinit(void);
 int             piperead(struct pipe*, char*, int);
 int             pipewrite(struct pipe*, char*, int);
+int             pipesize(struct pipe*);
+int             pipesetsize(struct pipe*, int);
 
 //PAGEBREAK: 16
 // proc.c
@@ -116,6 +168,7 @@ void            MLFQ_scheduler(void);
 void            MLFQ_scheduler2(void);
 void            scheduler(void) __attribute__((noreturn));
 void            sched(void);
+int             cswitches(void);
 void            sleep(void*, struct spinlock*);
 void            userinit(void);
 int             wait(void);
@@ -125,6 +178,7 @@ void            boost(void);
 int             set_cpu_share(int);
 int             removeProcPtr(struct proc *p);
 int             getminpass(void);
+char*           swapvictim(int, pde_t**);
 
 int             thread_create(thread_t *thread, void *(*start_routine)(void*), void *arg);
 void            thread_exit(void *retval) __attribute__((noreturn));
@@ -132,6 +186,16 @@ int             thread_join(thread_t thread, void **retval);
 int             cleanup_ustack(void);
 void            freeThreadPCB(struct proc *p);
 
+// swap.c
+void            swapinit(int);
+void            swapdup(uint);
+void            swapfree(uint);
+void            swapin(uint, char*);
+char*           kallocswap(void);
+void            pinuvm(void);
+void            unpinuvm(void);
+void            swapstat(uint*, uint*);
+
 // swtch.S
 void            swtch(struct context**, struct context*);
 
@@ -144,16 +208,20 @@ void            release(struct spinlock*);
 void            pushcli(void);
 void            popcli(void);
 
+// slab.c
+struct kmem_cache* kmem_cache_create(char*, uint, void (*)(void*));
+void*           kmem_cache_alloc(struct kmem_cache*);
+void            kmem_cache_free(struct kmem_cache*, void*);
+void            kmem_cache_dump(void);
+
 // sleeplock.c
 void            acquiresleep(struct sleeplock*);
 void            releasesleep(struct sleeplock*);
 int             holdingsleep(struct sleeplock*);
+int             holdingsleepself(struct sleeplock*);
 void            initsleeplock(struct sleeplock*, char*);
 
 // string.c
-int             memcmp(const void*, const void*, uint);
-void*           memmove(void*, const void*, uint);
-void*           memset(void*, int, uint);
 char*           safestrcpy(char*, const char*, int);
 int             strlen(const char*);
 int             strncmp(const char*, const char*, uint);
@@ -162,9 +230,9 @@ char*           strncpy(char*, const char*, int);
 // syscall.c
 int             argint(int, int*);
 int             argptr(int, char**, int);
-int             argstr(int, char**);
+int             argstr(int, char*, int);
 int             fetchint(uint, int*);
-int             fetchstr(uint, char**);
+int             fetchstr(uint, char*, int);
 void            syscall(void);
 
 // timer.c
@@ -181,6 +249,18 @@ void            uartinit(void);
 void            uartintr(void);
 void            uartputc(int);
 
+// usercopy.S
+int             ucopy(void*, void*, uint);
+int             ucopystr(char*, char*, uint);
+
+// virtio.c
+void            virtioinit(void);
+void            virtiointr(void);
+void            virtiorw(struct buf*);
+void            virtio_submit(struct buf*, void (*)(struct buf*));
+extern int      havevirtio;
+extern int      virtioirq;
+
 // vm.c
 void            seginit(void);
 void            kvmalloc(void);
@@ -195,7 +275,13 @@ pde_t*          copyuvm(pde_t*, uint, uint);
 void            switchuvm(struct proc*);
 void            switchkvm(void);
 int             copyout(pde_t*, uint, void*, uint);
+int             copyin(void*, uint, uint);
+int             copyinstr(char*, uint, uint);
 void            clearpteu(pde_t *pgdir, char *uva);
+void            tlbintr(void);
+void            tlbshootdown(pde_t*);
+pte_t*          walkpgdir(pde_t*, const void*, int);
+int             copyuvmrange(pde_t*, pde_t*, uint, uint, int);
 
 // prac_syscall.c
 int             my_syscall(char*);
@@ -0,0 +1,120 @@
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "fcntl.h"
+#include "fs.h"
+
+#define WSIZE  (128*1024)  // bytes each writer writes
+#define NREAD  64          // files each reader opens
+#define MAXF   64
+
+char buf[512];
+char names[MAXF][DIRSIZ+1];
+int nnames;
+
+void
+wname(char *path, int i)
+{
+  strcpy(path, "diskfile0");
+  path[8] = '0' + i;
+}
+
+// nproc processes each write WSIZE bytes to their own file.
+// Every write goes through the log to the disk.
+void
+writers(int nproc)
+{
+  char path[16];
+  int i, fd, n, t;
+
+  t = uptime();
+  for(i = 0; i < nproc; i++){
+    if(fork() == 0){
+      wname(path, i);
+      if((fd = open(path, O_CREATE | O_RDWR)) < 0)
+        exit();
+      for(n = 0; n < WSIZE; n += sizeof(buf))
+        write(fd, buf, sizeof(buf));
+      close(fd);
+      exit();
+    }
+  }
+  for(i = 0; i < nproc; i++)
+    wait();
+  t = uptime() - t;
+  if(t == 0)
+    t = 1;
+  printf(1, "%d sequential writers: %d KB in %d ticks, %d KB/s\n",
+         nproc, nproc * WSIZE / 1024, t, nproc * WSIZE / t * 100 / 1024);
+  for(i = 0; i < nproc; i++){
+    wname(path, i);
+    unlink(path);
+  }
+}
+
+// the regular files of the root directory, which mkfs wrote.
+void
+listfiles(void)
+{
+  struct dirent de;
+  struct stat st;
+  int fd;
+
+  if((fd = open("/", O_RDONLY)) < 0)
+    exit();
+  while(nnames < MAXF && read(fd, &de, sizeof(de)) == sizeof(de)){
+    if(de.inum == 0)
+      continue;
+    memmove(names[nnames], de.name, DIRSIZ);
+    names[nnames][DIRSIZ] = 0;
+    if(stat(names[nnames], &st) >= 0 && st.type == T_FILE)
+      nnames++;
+  }
+  close(fd);
+}
+
+// nproc processes each read the first block of NREAD files in a
+// random order: small reads scattered over the disk.  Blocks only
+// come from the disk the first time after boot.
+void
+readers(int nproc)
+{
+  uint hit0, miss0, hit, miss, seed;
+  int i, j, fd, t;
+
+  bstat(&hit0, &miss0);
+  t = uptime();
+  for(i = 0; i < nproc; i++){
+    if(fork() == 0){
+      seed = i * 7919 + uptime();
+      for(j = 0; j < NREAD; j++){
+        seed = seed * 1103515245 + 12345;
+        if((fd = open(names[(seed >> 8) % nnames], O_RDONLY)) < 0)
+          continue;
+        read(fd, buf, sizeof(buf));
+        close(fd);
+      }
+      exit();
+    }
+  }
+  for(i = 0; i < nproc; i++)
+    wait();
+  bstat(&hit, &miss);
+  printf(1, "%d random readers: %d reads in %d ticks, %d misses\n",
+         nproc, nproc * NREAD, uptime() - t, miss - miss0);
+}
+
+int
+main(int argc, char *argv[])
+{
+  printf(1, "diskbench starting\n");
+  listfiles();
+  if(nnames > 0){
+    readers(1);
+    readers(4);
+  }
+  writers(1);
+  writers(4);
+  printf(1, "diskbench done\n");
+  exit();
+}
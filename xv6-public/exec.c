@@ -6,16 +6,18 @@
 #include "defs.h"
 #include "x86.h"
 #include "elf.h"
+#include "mman.h"
 
 int
 exec(char *path, char **argv)
 {
   char *s, *last;
-  int i, off;
+  int i, off, nseg;
   uint argc, sz, sp, ustack[3+MAXARG+1];
   struct elfhdr elf;
   struct inode *ip;
   struct proghdr ph;
+  struct vma seg[NVMA];
   pde_t *pgdir, *oldpgdir;
 
   begin_op();
@@ -26,6 +28,7 @@ exec(char *path, char **argv)
   }
   ilock(ip);
   pgdir = 0;
+  nseg = 0;
 
   // Check ELF header
   if(readi(ip, (char*)&elf, 0, sizeof(elf)) != sizeof(elf))
@@ -36,7 +39,8 @@ exec(char *path, char **argv)
   if((pgdir = setupkvm()) == 0)
     goto bad;
 
-  // Load program into memory.
+  // Record the segments as private mappings of the file; their
+  // pages are read in by pagefault() when first touched.
   sz = 0;
   for(i=0, off=elf.phoff; i<elf.phnum; i++, off+=sizeof(ph)){
     if(readi(ip, (char*)&ph, off, sizeof(ph)) != sizeof(ph))
@@ -47,24 +51,35 @@ exec(char *path, char **argv)
       goto bad;
     if(ph.vaddr + ph.memsz < ph.vaddr)
       goto bad;
-    if((sz = allocuvm(pgdir, sz, ph.vaddr + ph.memsz)) == 0)
+    if(ph.vaddr % PGSIZE != 0 || ph.vaddr < sz)
       goto bad;
-    if(ph.vaddr % PGSIZE != 0)
-      goto bad;
-    if(loaduvm(pgdir, (char*)ph.vaddr, ip, ph.off, ph.filesz) < 0)
+    if(ph.vaddr + ph.memsz > MMAPBASE || nseg >= NVMA)
       goto bad;
+    seg[nseg].start = ph.vaddr;
+    seg[nseg].end = PGROUNDUP(ph.vaddr + ph.memsz);
+    seg[nseg].fend = ph.vaddr + ph.filesz;
+    seg[nseg].prot = PROT_READ;
+    if(ph.flags & ELF_PROG_FLAG_WRITE)
+      seg[nseg].prot |= PROT_WRITE;
+    seg[nseg].flags = MAP_PRIVATE;
+    seg[nseg].ip = idup(ip);
+    seg[nseg].off = ph.off;
+    pcachemap(pgdir, &seg[nseg]);
+    sz = seg[nseg++].end;
   }
   iunlockput(ip);
   end_op();
   ip = 0;
 
-  // LWP2 - 1.3.2.1 allocate stack area.
+  // LWP2 - 1.3.2.1 allocate stack area.  STACKLIMIT bytes are
+  // reserved below KERNBASE-PGSIZE, but only the top page, for
+  // the arguments, is mapped; pagefault() maps the rest as the
+  // stack grows into it (see stackpage).
   proc->topofheap = sz;
-  sz = PGROUNDUP(KERNBASE - 3*PGSIZE);
-  proc->baseofstack = sz;
-  if((sz = allocuvm(pgdir, sz, sz + 2*PGSIZE)) == 0)
+  sz = KERNBASE - PGSIZE;
+  proc->baseofstack = sz - STACKLIMIT;
+  if(allocuvm(pgdir, sz - PGSIZE, sz) == 0)
     goto bad;
-  clearpteu(pgdir, (char*)(sz - 2*PGSIZE));
   sp = sz;
 
   // Push argument strings, prepare rest of stack in ustack.
@@ -101,6 +116,8 @@ exec(char *path, char **argv)
   proc->tf->eip = elf.entry;  // main
   proc->tf->esp = sp;
   switchuvm(proc);
+  vmafree(proc->threadof ? proc->threadof : proc, oldpgdir);
+  vmaexec(proc->threadof ? proc->threadof : proc, seg, nseg);
   freevm(oldpgdir);
   return 0;
 
@@ -112,5 +129,11 @@ exec(char *path, char **argv)
     iunlockput(ip);
     end_op();
   }
+  if(nseg > 0){
+    begin_op();
+    for(i = 0; i < nseg; i++)
+      iput(seg[i].ip);
+    end_op();
+  }
   return -1;
 }
@@ -0,0 +1,59 @@
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "fcntl.h"
+
+#define NEXEC 100
+
+// time NEXEC fork()/exec()/exit()/wait() rounds of argv[0].  The
+// child's output is thrown away by closing its stdout.
+void
+execbench(char **argv)
+{
+  int i, pid, start;
+
+  start = uptime();
+  for(i = 0; i < NEXEC; i++){
+    pid = fork();
+    if(pid < 0){
+      printf(1, "fork failed at %d\n", i);
+      exit();
+    }
+    if(pid == 0){
+      close(1);
+      exec(argv[0], argv);
+      printf(2, "exec %s failed\n", argv[0]);
+      exit();
+    }
+    wait();
+  }
+  printf(1, "%s %s: %d execs in %d ticks\n", argv[0], argv[1] ? argv[1] : "",
+         NEXEC, uptime() - start);
+}
+
+int
+main(int argc, char *argv[])
+{
+  char *usertests[] = { "usertests", 0 };
+  char *bigbin[] = { "bigbin", 0 };
+  char *bigtouch[] = { "bigbin", "touch", 0 };
+  int fd, made;
+
+  printf(1, "execbench starting\n");
+  // usertests quits right after starting when this file exists,
+  // so each round is exec to main() and back.
+  made = 0;
+  if((fd = open("usertests.ran", 0)) < 0){
+    fd = open("usertests.ran", O_CREATE);
+    made = 1;
+  }
+  close(fd);
+  execbench(usertests);
+  if(made)
+    unlink("usertests.ran");
+
+  execbench(bigbin);
+  execbench(bigtouch);
+  printf(1, "execbench done\n");
+  exit();
+}
@@ -2,3 +2,12 @@
 #define O_WRONLY  0x001
 #define O_RDWR    0x002
 #define O_CREATE  0x200
+
+// lseek() whence
+#define SEEK_SET  0
+#define SEEK_CUR  1
+#define SEEK_END  2
+
+// fcntl() commands
+#define F_SETPIPE_SZ 1031  // set a pipe's capacity in bytes
+#define F_GETPIPE_SZ 1032  // get a pipe's capacity in bytes
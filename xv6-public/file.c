@@ -10,16 +10,24 @@
 #include "sleeplock.h"
 #include "file.h"
 
+#define RAMIN 4    // first read-ahead window, in blocks
+#define RAMAX 64   // largest read-ahead window
+
 struct devsw devsw[NDEV];
+
+// File structures come from a slab cache instead of a fixed
+// table, so the number of open files is bounded only by memory.
+// ftable.lock protects the ref counts.
 struct {
   struct spinlock lock;
-  struct file file[NFILE];
+  struct kmem_cache *cache;
 } ftable;
 
 void
 fileinit(void)
 {
   initlock(&ftable.lock, "ftable");
+  ftable.cache = kmem_cache_create("file", sizeof(struct file), 0);
 }
 
 // Allocate a file structure.
@@ -28,16 +36,11 @@ filealloc(void)
 {
   struct file *f;
 
-  acquire(&ftable.lock);
-  for(f = ftable.file; f < ftable.file + NFILE; f++){
-    if(f->ref == 0){
-      f->ref = 1;
-      release(&ftable.lock);
-      return f;
-    }
-  }
-  release(&ftable.lock);
-  return 0;
+  if((f = kmem_cache_alloc(ftable.cache)) == 0)
+    return 0;
+  memset(f, 0, sizeof(*f));
+  f->ref = 1;
+  return f;
 }
 
 // Increment ref count for file f.
@@ -69,6 +72,7 @@ fileclose(struct file *f)
   f->ref = 0;
   f->type = FD_NONE;
   release(&ftable.lock);
+  kmem_cache_free(ftable.cache, f);
 
   if(ff.type == FD_PIPE)
     pipeclose(ff.pipe, ff.writable);
@@ -92,6 +96,36 @@ filestat(struct file *f, struct stat *st)
   return -1;
 }
 
+// Keep reading ahead of a sequential reader of f, which has just
+// read [start, f->off).  The window starts at RAMIN blocks and
+// doubles with every sequential read up to RAMAX; any other read
+// turns read-ahead off until the reads are sequential again.
+// Caller holds f->ip->lock.
+static void
+readahead(struct file *f, uint start)
+{
+  uint bn;
+
+  if(start != f->raoff){
+    f->raoff = f->off;
+    f->rawin = 0;
+    f->ranext = 0;
+    return;
+  }
+  f->raoff = f->off;
+  if(f->rawin == 0)
+    f->rawin = RAMIN;
+  else if(f->rawin < RAMAX)
+    f->rawin *= 2;
+  bn = f->off / BSIZE;
+  if(f->ranext < bn)
+    f->ranext = bn;
+  if(f->ranext < bn + f->rawin){
+    ireadahead(f->ip, f->ranext, bn + f->rawin - f->ranext);
+    f->ranext = bn + f->rawin;
+  }
+}
+
 // Read from file f.
 int
 fileread(struct file *f, char *addr, int n)
@@ -104,8 +138,10 @@ fileread(struct file *f, char *addr, int n)
     return piperead(f->pipe, addr, n);
   if(f->type == FD_INODE){
     ilock(f->ip);
-    if((r = readi(f->ip, addr, f->off, n)) > 0)
+    if((r = readi(f->ip, addr, f->off, n)) > 0){
       f->off += r;
+      readahead(f, f->off - r);
+    }
     iunlock(f->ip);
     return r;
   }
@@ -130,7 +166,7 @@ filewrite(struct file *f, char *addr, int n)
     // and 2 blocks of slop for non-aligned writes.
     // this really belongs lower down, since writei()
     // might be writing a device like the console.
-    int max = ((LOGSIZE-1-1-2) / 2) * 512;
+    int max = ((LOGSIZE-1-1-2) / 2) * BSIZE;
     int i = 0;
     while(i < n){
       int n1 = n - i;
@@ -146,11 +182,11 @@ filewrite(struct file *f, char *addr, int n)
 
       if(r < 0)
         break;
-      if(r != n1)
-        panic("short filewrite");
       i += r;
+      if(r != n1)
+        break;  // a bad user address part way
     }
-    return i == n ? n : -1;
+    return i > 0 || n == 0 ? i : -1;
   }
   panic("filewrite");
 }
@@ -6,9 +6,14 @@ struct file {
   struct pipe *pipe;
   struct inode *ip;
   uint off;
+  uint raoff;   // offset a sequential read would start at
+  uint rawin;   // read-ahead window, in blocks
+  uint ranext;  // first block not read ahead yet
 };
 
 
+#define NIMAP 8  // block map runs kept per inode
+
 // in-memory copy of an inode
 struct inode {
   uint dev;           // Device number
@@ -16,6 +21,9 @@ struct inode {
   int ref;            // Reference count
   struct sleeplock lock;
   int flags;          // I_VALID
+  struct inode *next; // hash bucket list
+  struct inode *lprev; // idle LRU list
+  struct inode *lnext;
 
   short type;         // copy of disk inode
   short major;
@@ -23,6 +31,14 @@ struct inode {
   short nlink;
   uint size;
   uint addrs[NDIRECT+1+1];
+
+  struct irun {       // recently used runs of the block map
+    uint lbn;         // first file block
+    uint pbn;         // its disk block
+    uint len;         // blocks in the run; 0 if unused
+  } map[NIMAP];
+  uint mapnext;       // map[] entry to replace next
+  uint bnext;         // where to look for its next block
 };
 #define I_VALID 0x2
 
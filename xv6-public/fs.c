@@ -14,6 +14,7 @@
 #include "param.h"
 #include "stat.h"
 #include "mmu.h"
+#include "x86.h"
 #include "proc.h"
 #include "spinlock.h"
 #include "sleeplock.h"
@@ -52,29 +53,121 @@ bzero(int dev, int bno)
 
 // Blocks.
 
-// Allocate a zeroed disk block.
-static uint
-balloc(uint dev)
+// In-core summary of the free block bitmap: how many blocks each
+// bitmap block has free, so that searches pass over full ones
+// without reading them, and a next-fit cursor where the last
+// allocation left off.  A count only changes while its bitmap
+// block's buffer is locked, so the counts stay exact.
+struct {
+  struct spinlock lock;
+  uint *nfree;  // free blocks per bitmap block
+  uint nbmap;   // bitmap blocks
+  uint total;   // free blocks in all
+  uint rover;   // where a search without a goal starts
+} bsum;
+
+// Count the free blocks of each bitmap block.  Runs after
+// initlog(), which may have replayed bitmap blocks.
+void
+bsuminit(int dev)
 {
-  int b, bi, m;
+  uint b, bi;
   struct buf *bp;
 
-  bp = 0;
+  initlock(&bsum.lock, "bsum");
+  bsum.nbmap = (sb.size + BPB - 1) / BPB;
+  if(bsum.nbmap > PGSIZE / sizeof(uint))
+    panic("bsuminit: bitmap too big");
+  if((bsum.nfree = (uint*)kalloc()) == 0)
+    panic("bsuminit: kalloc");
   for(b = 0; b < sb.size; b += BPB){
     bp = bread(dev, BBLOCK(b, sb));
-    for(bi = 0; bi < BPB && b + bi < sb.size; bi++){
-      m = 1 << (bi % 8);
-      if((bp->data[bi/8] & m) == 0){  // Is block free?
-        bp->data[bi/8] |= m;  // Mark block in use.
-        log_write(bp);
-        brelse(bp);
-        bzero(dev, b + bi);
-        return b + bi;
-      }
+    bsum.nfree[b/BPB] = 0;
+    for(bi = 0; bi < BPB && b + bi < sb.size; bi++)
+      if((bp->data[bi/8] & (1 << (bi % 8))) == 0)
+        bsum.nfree[b/BPB]++;
+    bsum.total += bsum.nfree[b/BPB];
+    brelse(bp);
+  }
+}
+
+// Number of free blocks on the disk.
+uint
+nfreeblocks(void)
+{
+  return bsum.total;
+}
+
+// Take the first free block in [from, to), or return 0.
+// Skips bitmap blocks the summary shows are full, and tests
+// the bitmap a word at a time.
+static uint
+bscan(uint dev, uint from, uint to)
+{
+  uint b, bi, w, *map;
+  struct buf *bp;
+
+  for(b = from - from % BPB; b < to; b += BPB){
+    acquire(&bsum.lock);
+    w = bsum.nfree[b/BPB];
+    release(&bsum.lock);
+    if(w == 0)
+      continue;
+    bp = bread(dev, BBLOCK(b, sb));
+    map = (uint*)bp->data;
+    for(bi = b < from ? from - b : 0; bi < BPB && b + bi < to;
+        bi = (bi + 32) & ~31){
+      w = ~map[bi/32] & (~0U << (bi % 32));  // free blocks from bi on
+      if(w == 0)
+        continue;
+      bi += bsf(w) - bi % 32;
+      if(b + bi >= to)
+        break;
+      map[bi/32] |= 1 << (bi % 32);  // Mark block in use.
+      log_write(bp);
+      acquire(&bsum.lock);
+      bsum.nfree[b/BPB]--;
+      bsum.total--;
+      bsum.rover = b + bi + 1;
+      release(&bsum.lock);
+      brelse(bp);
+      return b + bi;
     }
     brelse(bp);
   }
-  panic("balloc: out of blocks");
+  return 0;
+}
+
+// Allocate a zeroed disk block: the first free one at or after
+// goal, so that a file can grow in place, else any.  Without a
+// goal the search starts where the last one ended.
+static uint
+balloc(uint dev, uint goal)
+{
+  uint b;
+
+  if(goal == 0 || goal >= sb.size){
+    acquire(&bsum.lock);
+    goal = bsum.rover < sb.size ? bsum.rover : 0;
+    release(&bsum.lock);
+  }
+  if((b = bscan(dev, goal, sb.size)) == 0 && (b = bscan(dev, 0, goal)) == 0)
+    panic("balloc: out of blocks");
+  bzero(dev, b);
+  return b;
+}
+
+// Allocate a block for ip just after the last one it got, if
+// that is free, so that a file written in order is laid out in
+// order.
+static uint
+iballoc(struct inode *ip)
+{
+  uint b;
+
+  b = balloc(ip->dev, ip->bnext);
+  ip->bnext = b + 1;
+  return b;
 }
 
 // Free a disk block.
@@ -84,7 +177,6 @@ bfree(int dev, uint b)
   struct buf *bp;
   int bi, m;
 
-  readsb(dev, &sb);
   bp = bread(dev, BBLOCK(b, sb));
   bi = b % BPB;
   m = 1 << (bi % 8);
@@ -92,6 +184,10 @@ bfree(int dev, uint b)
     panic("freeing free block");
   bp->data[bi/8] &= ~m;
   log_write(bp);
+  acquire(&bsum.lock);
+  bsum.nfree[b/BPB]++;
+  bsum.total++;
+  release(&bsum.lock);
   brelse(bp);
 }
 
@@ -121,11 +217,11 @@ bfree(int dev, uint b)
 //   the link count has fallen to zero.
 //
 // * Referencing in cache: an entry in the inode cache
-//   is free if ip->ref is zero. Otherwise ip->ref tracks
+//   exists only while ip->ref is non-zero; ip->ref tracks
 //   the number of in-memory pointers to the entry (open
 //   files and current directories). iget() to find or
 //   create a cache entry and increment its ref, iput()
-//   to decrement ref.
+//   to decrement ref and free the entry at zero.
 //
 // * Valid: the information (type, size, &c) in an inode
 //   cache entry is only correct when the I_VALID bit
@@ -155,41 +251,90 @@ bfree(int dev, uint b)
 // have locked the inodes involved; this lets callers create
 // multi-step atomic operations.
 
-struct {
+#define NIBUCKET 61  // hash buckets, a prime
+
+// The cache itself is a hash table of in-memory inodes allocated
+// from a slab cache, so it grows with the number of referenced
+// inodes instead of being limited to a fixed table.  Inodes are
+// hashed by (dev, inum) into NIBUCKET buckets; a bucket's lock
+// protects its list and the ref of its inodes, so that lookups
+// of inodes that are in use do not contend.
+//
+// When its last reference goes, a valid inode stays cached on an
+// LRU list of idle inodes, so that the next iget() and ilock()
+// of it need not read the disk.  icache.lock protects that list
+// and is taken before a bucket lock.  An inode only moves on or
+// off the list with both held, and only a process holding
+// icache.lock takes a second bucket lock, to evict an idle inode
+// from its bucket, so the locks cannot deadlock.
+struct ibucket {
   struct spinlock lock;
-  struct inode inode[NINODE];
+  struct inode *head;  // the bucket's inodes, through next
+};
+
+struct {
+  struct spinlock lock;  // the idle list, nidle and ifree
+  struct kmem_cache *cache;
+  // Idle inodes (ref == 0, I_VALID), through lprev/lnext,
+  // from most (mru) to least (lru) recently used.
+  struct inode *mru;
+  struct inode *lru;
+  int nidle;
+  uint ifree;  // ialloc() starts looking for a free inode here
+  struct ibucket bucket[NIBUCKET];
 } icache;
 
+static void
+inodector(void *v)
+{
+  initsleeplock(&((struct inode*)v)->lock, "inode");
+}
+
 void
-iinit(int dev)
+icacheinit(void)
 {
-  int i = 0;
-  
+  struct ibucket *bk;
+
   initlock(&icache.lock, "icache");
-  for(i = 0; i < NINODE; i++) {
-    initsleeplock(&icache.inode[i].lock, "inode");
-  }
-  
+  icache.cache = kmem_cache_create("inode", sizeof(struct inode), inodector);
+  icache.ifree = 1;
+  for(bk = icache.bucket; bk < &icache.bucket[NIBUCKET]; bk++)
+    initlock(&bk->lock, "icache.bucket");
+}
+
+void
+iinit(int dev)
+{
   readsb(dev, &sb);
+  if(sb.bsize == 0)
+    sb.bsize = 512;
   cprintf("sb: size %d nblocks %d ninodes %d nlog %d logstart %d\
- inodestart %d bmap start %d\n", sb.size, sb.nblocks,
+ inodestart %d bmap start %d bsize %d%s\n", sb.size, sb.nblocks,
           sb.ninodes, sb.nlog, sb.logstart, sb.inodestart,
-          sb.bmapstart);
+          sb.bmapstart, sb.bsize, (sb.flags & FS_EXTENT) ? " extents" : "");
+  if(sb.bsize != BSIZE)
+    panic("iinit: file system block size is not BSIZE");
 }
 
 static struct inode* iget(uint dev, uint inum);
 
 //PAGEBREAK!
 // Allocate a new inode with the given type on device dev.
-// A free inode has a type of zero.
+// A free inode has a type of zero.  The search starts at
+// icache.ifree, below which all inodes were in use when last
+// looked, and wraps around.
 struct inode*
 ialloc(uint dev, short type)
 {
-  int inum;
+  uint i, inum, start;
   struct buf *bp;
   struct dinode *dip;
 
-  for(inum = 1; inum < sb.ninodes; inum++){
+  acquire(&icache.lock);
+  start = icache.ifree;
+  release(&icache.lock);
+  for(i = 0; i < sb.ninodes - 1; i++){
+    inum = 1 + (start - 1 + i) % (sb.ninodes - 1);
     bp = bread(dev, IBLOCK(inum, sb));
     dip = (struct dinode*)bp->data + inum%IPB;
     if(dip->type == 0){  // a free inode
@@ -197,6 +342,10 @@ ialloc(uint dev, short type)
       dip->type = type;
       log_write(bp);   // mark it allocated on the disk
       brelse(bp);
+      acquire(&icache.lock);
+      if(icache.ifree == start)
+        icache.ifree = inum + 1;
+      release(&icache.lock);
       return iget(dev, inum);
     }
     brelse(bp);
@@ -223,37 +372,126 @@ iupdate(struct inode *ip)
   brelse(bp);
 }
 
+static struct ibucket*
+ihash(uint dev, uint inum)
+{
+  return &icache.bucket[(dev * 31 + inum) % NIBUCKET];
+}
+
+// Find inode inum of dev in bk.  Caller holds bk->lock.
+static struct inode*
+ifind(struct ibucket *bk, uint dev, uint inum)
+{
+  struct inode *ip;
+
+  for(ip = bk->head; ip; ip = ip->next)
+    if(ip->dev == dev && ip->inum == inum)
+      return ip;
+  return 0;
+}
+
+// Remove ip from bk.  Caller holds bk->lock.
+static void
+iunhash(struct ibucket *bk, struct inode *ip)
+{
+  struct inode **pp;
+
+  for(pp = &bk->head; *pp != ip; pp = &(*pp)->next)
+    ;
+  *pp = ip->next;
+}
+
+// Put ip at the MRU end of the idle list.  Caller holds
+// icache.lock.
+static void
+iidle(struct inode *ip)
+{
+  ip->lprev = 0;
+  ip->lnext = icache.mru;
+  if(icache.mru)
+    icache.mru->lprev = ip;
+  else
+    icache.lru = ip;
+  icache.mru = ip;
+  icache.nidle++;
+}
+
+static void
+iunidle(struct inode *ip)
+{
+  if(ip->lprev)
+    ip->lprev->lnext = ip->lnext;
+  else
+    icache.mru = ip->lnext;
+  if(ip->lnext)
+    ip->lnext->lprev = ip->lprev;
+  else
+    icache.lru = ip->lprev;
+  icache.nidle--;
+}
+
+// Take the least recently used idle inode out of the cache, or
+// return 0 if there is none.  Caller holds icache.lock and
+// bk->lock; bk may be the victim's own bucket.
+static struct inode*
+isteal(struct ibucket *bk)
+{
+  struct ibucket *v;
+  struct inode *ip;
+
+  if((ip = icache.lru) == 0)
+    return 0;
+  iunidle(ip);
+  v = ihash(ip->dev, ip->inum);
+  if(v != bk)
+    acquire(&v->lock);
+  iunhash(v, ip);
+  if(v != bk)
+    release(&v->lock);
+  return ip;
+}
+
 // Find the inode with number inum on device dev
 // and return the in-memory copy. Does not lock
 // the inode and does not read it from disk.
 static struct inode*
 iget(uint dev, uint inum)
 {
-  struct inode *ip, *empty;
+  struct ibucket *bk;
+  struct inode *ip;
 
-  acquire(&icache.lock);
+  // An inode in use only needs its bucket.
+  bk = ihash(dev, inum);
+  acquire(&bk->lock);
+  if((ip = ifind(bk, dev, inum)) != 0 && ip->ref > 0){
+    ip->ref++;
+    release(&bk->lock);
+    return ip;
+  }
+  release(&bk->lock);
 
-  // Is the inode already cached?
-  empty = 0;
-  for(ip = &icache.inode[0]; ip < &icache.inode[NINODE]; ip++){
-    if(ip->ref > 0 && ip->dev == dev && ip->inum == inum){
-      ip->ref++;
-      release(&icache.lock);
-      return ip;
-    }
-    if(empty == 0 && ip->ref == 0)    // Remember empty slot.
-      empty = ip;
+  // An idle or uncached one changes the idle list.
+  acquire(&icache.lock);
+  acquire(&bk->lock);
+  if((ip = ifind(bk, dev, inum)) != 0){
+    if(ip->ref++ == 0)
+      iunidle(ip);
+    release(&bk->lock);
+    release(&icache.lock);
+    return ip;
   }
 
-  // Recycle an inode cache entry.
-  if(empty == 0)
+  // Allocate a new inode cache entry, or reuse an idle one.
+  if((ip = kmem_cache_alloc(icache.cache)) == 0 && (ip = isteal(bk)) == 0)
     panic("iget: no inodes");
 
-  ip = empty;
   ip->dev = dev;
   ip->inum = inum;
   ip->ref = 1;
   ip->flags = 0;
+  ip->next = bk->head;
+  bk->head = ip;
+  release(&bk->lock);
   release(&icache.lock);
 
   return ip;
@@ -264,9 +502,12 @@ iget(uint dev, uint inum)
 struct inode*
 idup(struct inode *ip)
 {
-  acquire(&icache.lock);
+  struct ibucket *bk;
+
+  bk = ihash(ip->dev, ip->inum);
+  acquire(&bk->lock);
   ip->ref++;
-  release(&icache.lock);
+  release(&bk->lock);
   return ip;
 }
 
@@ -293,6 +534,8 @@ ilock(struct inode *ip)
     ip->size = dip->size;
     memmove(ip->addrs, dip->addrs, sizeof(ip->addrs));
     brelse(bp);
+    memset(ip->map, 0, sizeof(ip->map));
+    ip->bnext = 0;
     ip->flags |= I_VALID;
     if(ip->type == 0)
       panic("ilock: no type");
@@ -310,8 +553,10 @@ iunlock(struct inode *ip)
 }
 
 // Drop a reference to an in-memory inode.
-// If that was the last reference, the inode cache entry can
-// be recycled.
+// If that was the last reference, a valid inode goes on the
+// idle list, from which the least recently used are returned to
+// the slab cache once there are more than NIDLEINODE; any other
+// entry is returned at once.
 // If that was the last reference and the inode has no links
 // to it, free the inode (and its content) on disk.
 // All calls to iput() must be inside a transaction in
@@ -319,18 +564,51 @@ iunlock(struct inode *ip)
 void
 iput(struct inode *ip)
 {
-  acquire(&icache.lock);
+  struct ibucket *bk;
+  struct inode *victim;
+
+  bk = ihash(ip->dev, ip->inum);
+  acquire(&bk->lock);
   if(ip->ref == 1 && (ip->flags & I_VALID) && ip->nlink == 0){
     // inode has no links and no other references: truncate and free.
-    release(&icache.lock);
+    release(&bk->lock);
     itrunc(ip);
     ip->type = 0;
     iupdate(ip);
     acquire(&icache.lock);
+    if(ip->inum < icache.ifree)
+      icache.ifree = ip->inum;
+    release(&icache.lock);
+    acquire(&bk->lock);
     ip->flags = 0;
   }
-  ip->ref--;
+  if(ip->ref > 1){
+    ip->ref--;
+    release(&bk->lock);
+    return;
+  }
+  release(&bk->lock);
+
+  acquire(&icache.lock);
+  acquire(&bk->lock);
+  if(--ip->ref > 0){  // an iget() came in meanwhile
+    release(&bk->lock);
+    release(&icache.lock);
+    return;
+  }
+  victim = 0;
+  if(ip->flags & I_VALID){
+    iidle(ip);
+    if(icache.nidle > NIDLEINODE)
+      victim = isteal(bk);
+  } else {
+    iunhash(bk, ip);
+    victim = ip;
+  }
+  release(&bk->lock);
   release(&icache.lock);
+  if(victim)
+    kmem_cache_free(icache.cache, victim);
 }
 
 // Common idiom: unlock, then put.
@@ -348,18 +626,112 @@ iunlockput(struct inode *ip)
 // in blocks on the disk. The first NDIRECT block numbers
 // are listed in ip->addrs[].  The next NINDIRECT blocks are
 // listed in block ip->addrs[NDIRECT].
+// On a file system with FS_EXTENT, ip->addrs[] holds extents
+// instead; see emap().
+
+// Return the disk block address of block bn of an extent-format
+// inode, and in *run how many blocks from there on are
+// consecutive on the disk.  If bn is just past the last block,
+// emap allocates one, right after the last run if it can, and
+// chains on another block of runs when the last one is full.
+static uint
+emap(struct inode *ip, uint bn, uint *run)
+{
+  struct extent *e, *last;
+  struct buf *bp;
+  uint i, n, fbn, addr, next, *link;
+
+  bp = 0;
+  last = 0;
+  fbn = 0;
+  e = (struct extent*)ip->addrs;
+  n = NEXTENT;
+  link = &ip->addrs[EXTBLOCK];
+  for(;;){
+    for(i = 0; i < n && e[i].len; i++){
+      if(bn < fbn + e[i].len){
+        addr = e[i].start + (bn - fbn);
+        *run = e[i].len - (bn - fbn);
+        if(bp)
+          brelse(bp);
+        return addr;
+      }
+      fbn += e[i].len;
+      last = &e[i];
+    }
+    if(i < n || *link == 0)
+      break;
+    // A chained block is never empty, so last will be in it.
+    next = *link;
+    if(bp)
+      brelse(bp);
+    bp = bread(ip->dev, next);
+    e = (struct extent*)bp->data;
+    n = NEXTENTB;
+    link = &e[NEXTENTB].start;
+    last = 0;
+  }
+  if(bn != fbn)
+    panic("emap: hole");
+
+  if(last)
+    ip->bnext = last->start + last->len;
+  addr = iballoc(ip);
+  if(last && addr == last->start + last->len)
+    last->len++;
+  else {
+    if(i == n){
+      // Full: chain on a new block of runs.
+      next = balloc(ip->dev, 0);
+      *link = next;
+      if(bp){
+        log_write(bp);
+        brelse(bp);
+      }
+      bp = bread(ip->dev, next);
+      e = (struct extent*)bp->data;
+      i = 0;
+    }
+    e[i].start = addr;
+    e[i].len = 1;
+  }
+  if(bp){
+    log_write(bp);
+    brelse(bp);
+  }
+  *run = 1;
+  return addr;
+}
 
-// Return the disk block address of the nth block in inode ip.
-// If there is no such block, bmap allocates one.
+// How many of the n block numbers from a[0] on are consecutive
+// on the disk.
 static uint
-bmap(struct inode *ip, uint bn)
+runlen(uint *a, uint n)
+{
+  uint i;
+
+  for(i = 1; i < n && a[i] == a[0] + i; i++)
+    ;
+  return i;
+}
+
+// Return the disk block address of the nth block in an inode
+// with the direct, indirect and double-indirect block map, and
+// in *run how many blocks from there on are consecutive, as far
+// as the block holding the address shows.
+// If there is no such block, blkmap allocates one.
+static uint
+blkmap(struct inode *ip, uint bn, uint *run)
 {
   uint addr, *a, *a2;
   struct buf *bp, *bp2;
 
+  *run = 1;
   if(bn < NDIRECT){
     if((addr = ip->addrs[bn]) == 0)
-      ip->addrs[bn] = addr = balloc(ip->dev);
+      ip->addrs[bn] = addr = iballoc(ip);
+    else
+      *run = runlen(&ip->addrs[bn], NDIRECT - bn);
     return addr;
   }
   bn -= NDIRECT;
@@ -367,13 +739,14 @@ bmap(struct inode *ip, uint bn)
   if(bn < NINDIRECT){
     // Load indirect block, allocating if necessary.
     if((addr = ip->addrs[NDIRECT]) == 0)
-      ip->addrs[NDIRECT] = addr = balloc(ip->dev);
+      ip->addrs[NDIRECT] = addr = iballoc(ip);
     bp = bread(ip->dev, addr);
     a = (uint*)bp->data;
     if((addr = a[bn]) == 0){
-      a[bn] = addr = balloc(ip->dev);
+      a[bn] = addr = iballoc(ip);
       log_write(bp);
-    }
+    } else
+      *run = runlen(&a[bn], NINDIRECT - bn);
     brelse(bp);
     return addr;
   }
@@ -382,12 +755,12 @@ bmap(struct inode *ip, uint bn)
   // FS - 2. bmap: assign data block in double indirect.
   if(bn < NDOUBLEINDIRECT){
     if((addr = ip->addrs[NDIRECT+1]) == 0)
-      ip->addrs[NDIRECT+1] = addr = balloc(ip->dev);
+      ip->addrs[NDIRECT+1] = addr = iballoc(ip);
 
     bp = bread(ip->dev, addr);
     a = (uint*)bp->data;
     if((addr = a[bn/NINDIRECT]) == 0){
-      a[bn/NINDIRECT] = addr = balloc(ip->dev);
+      a[bn/NINDIRECT] = addr = iballoc(ip);
       log_write(bp);
     }
     brelse(bp);
@@ -395,9 +768,10 @@ bmap(struct inode *ip, uint bn)
     bp2 = bread(ip->dev, addr);
     a2 = (uint*)bp2->data;
     if((addr = a2[bn%NINDIRECT]) == 0){
-      a2[bn%NINDIRECT] = addr = balloc(ip->dev);
+      a2[bn%NINDIRECT] = addr = iballoc(ip);
       log_write(bp2);
-    }
+    } else
+      *run = runlen(&a2[bn%NINDIRECT], NINDIRECT - bn%NINDIRECT);
     brelse(bp2);
 
     return addr;
@@ -406,6 +780,109 @@ bmap(struct inode *ip, uint bn)
   panic("bmap: out of range");
 }
 
+// Remember that blocks [lbn, lbn+len) of ip are at [pbn, pbn+len)
+// on the disk.  A run that overlaps or touches a remembered one on
+// the same line merges with it, so a file laid out in order ends
+// up as a few long runs.  Otherwise the oldest entry goes.
+static void
+imapadd(struct inode *ip, uint lbn, uint pbn, uint len)
+{
+  struct irun *r, *m;
+  uint end;
+
+  m = 0;
+  for(r = ip->map; r < &ip->map[NIMAP]; r++){
+    if(r->len == 0 || r->pbn - r->lbn != pbn - lbn ||
+       r->lbn > lbn + len || lbn > r->lbn + r->len)
+      continue;
+    end = lbn + len > r->lbn + r->len ? lbn + len : r->lbn + r->len;
+    if(r->lbn < lbn){
+      pbn -= lbn - r->lbn;
+      lbn = r->lbn;
+    }
+    len = end - lbn;
+    if(m)
+      r->len = 0;
+    else
+      m = r;
+  }
+  if(m == 0){
+    m = &ip->map[ip->mapnext];
+    ip->mapnext = (ip->mapnext + 1) % NIMAP;
+  }
+  m->lbn = lbn;
+  m->pbn = pbn;
+  m->len = len;
+}
+
+// Return the disk block address of the nth block in inode ip,
+// and in *run how many blocks from there on are consecutive.
+// Runs found once are kept in ip->map, so reads of a large file
+// seldom go back to its indirect or extent blocks.
+// If there is no such block, bmaprun allocates one.
+static uint
+bmaprun(struct inode *ip, uint bn, uint *run)
+{
+  struct irun *r;
+  uint addr;
+
+  for(r = ip->map; r < &ip->map[NIMAP]; r++){
+    if(r->len && bn - r->lbn < r->len){
+      *run = r->len - (bn - r->lbn);
+      return r->pbn + (bn - r->lbn);
+    }
+  }
+  if(sb.flags & FS_EXTENT)
+    addr = emap(ip, bn, run);
+  else
+    addr = blkmap(ip, bn, run);
+  imapadd(ip, bn, addr, *run);
+  return addr;
+}
+
+static uint
+bmap(struct inode *ip, uint bn)
+{
+  uint run;
+
+  return bmaprun(ip, bn, &run);
+}
+
+// Free the blocks of an extent-format inode, and its chain of
+// blocks of runs.
+static void
+etrunc(struct inode *ip)
+{
+  struct extent *e;
+  struct buf *bp;
+  uint i, n, b, cur, next;
+
+  bp = 0;
+  cur = 0;
+  e = (struct extent*)ip->addrs;
+  n = NEXTENT;
+  next = ip->addrs[EXTBLOCK];
+  for(;;){
+    for(i = 0; i < n && e[i].len; i++)
+      for(b = 0; b < e[i].len; b++)
+        bfree(ip->dev, e[i].start + b);
+    if(bp){
+      brelse(bp);
+      bfree(ip->dev, cur);
+    }
+    if((cur = next) == 0)
+      break;
+    bp = bread(ip->dev, cur);
+    e = (struct extent*)bp->data;
+    n = NEXTENTB;
+    next = e[NEXTENTB].start;
+  }
+
+  memset(ip->addrs, 0, sizeof(ip->addrs));
+  ip->size = 0;
+  iupdate(ip);
+}
+
 // Truncate inode (discard contents).
 // Only called when the inode has no links
 // to it (no directory entries referring to it)
@@ -418,6 +895,13 @@ itrunc(struct inode *ip)
   struct buf *bp, *bp2;
   uint *a, *a2;
 
+  pcacheinval(ip);
+  memset(ip->map, 0, sizeof(ip->map));
+  ip->bnext = 0;
+  if(sb.flags & FS_EXTENT){
+    etrunc(ip);
+    return;
+  }
   for(i = 0; i < NDIRECT; i++){
     if(ip->addrs[i]){
       bfree(ip->dev, ip->addrs[i]);
@@ -463,6 +947,35 @@ itrunc(struct inode *ip)
   iupdate(ip);
 }
 
+// Blocks that hold ip's block map rather than data.
+static uint
+imeta(struct inode *ip)
+{
+  struct buf *bp;
+  uint i, n, *a;
+
+  if(sb.flags & FS_EXTENT){
+    n = 0;
+    for(i = ip->addrs[EXTBLOCK]; i; n++){
+      bp = bread(ip->dev, i);
+      i = ((struct extent*)bp->data)[NEXTENTB].start;
+      brelse(bp);
+    }
+    return n;
+  }
+  n = ip->addrs[NDIRECT] != 0;
+  if(ip->addrs[NDIRECT+1]){
+    n++;
+    bp = bread(ip->dev, ip->addrs[NDIRECT+1]);
+    a = (uint*)bp->data;
+    for(i = 0; i < NINDIRECT; i++)
+      if(a[i])
+        n++;
+    brelse(bp);
+  }
+  return n;
+}
+
 // Copy stat information from inode.
 void
 stati(struct inode *ip, struct stat *st)
@@ -472,6 +985,7 @@ stati(struct inode *ip, struct stat *st)
   st->type = ip->type;
   st->nlink = ip->nlink;
   st->size = ip->size;
+  st->nmeta = imeta(ip);
 }
 
 //PAGEBREAK!
@@ -503,10 +1017,36 @@ readi(struct inode *ip, char *dst, uint off, uint n)
     }
     cprintf("\n");
     */
-    memmove(dst, bp->data + off%BSIZE, m);
+    // dst may be a bad user address.  A good one was faulted in
+    // by sys_read: a fault here, with bp locked, could need bp.
+    if(ucopy(dst, bp->data + off%BSIZE, m) < 0){
+      brelse(bp);
+      break;
+    }
     brelse(bp);
   }
-  return n;
+  if(tot < n && tot == 0)
+    return -1;
+  return tot;
+}
+
+// Start reading the n blocks of ip from block bn on into the
+// buffer cache, without waiting for them, for a sequential
+// reader.  Stops at the end of the file.  Caller must hold
+// ip->lock.
+void
+ireadahead(struct inode *ip, uint bn, uint n)
+{
+  uint end, addr, run;
+
+  if(ip->type == T_DEV)
+    return;
+  end = (ip->size + BSIZE - 1) / BSIZE;
+  while(n > 0 && bn < end){
+    addr = bmaprun(ip, bn, &run);
+    for(; run > 0 && n > 0 && bn < end; run--, n--, bn++)
+      bprefetch(ip->dev, addr++);
+  }
 }
 
 // PAGEBREAK!
@@ -525,22 +1065,34 @@ writei(struct inode *ip, char *src, uint off, uint n)
 
   if(off > ip->size || off + n < off)
     return -1;
-  if(off + n > MAXFILE*BSIZE)
+  if(n > 0 && (off + n - 1) / BSIZE >=
+     ((sb.flags & FS_EXTENT) ? EMAXFILE : MAXFILE))
     return -1;
+  if(ip->type == T_FILE)
+    pcacheinval(ip);  // cached pages go stale
 
   for(tot=0; tot<n; tot+=m, off+=m, src+=m){
     bp = bread(ip->dev, bmap(ip, off/BSIZE));
     m = min(n - tot, BSIZE - off%BSIZE);
-    memmove(bp->data + off%BSIZE, src, m);
+    // src may be a bad user address; see readi.
+    if(ucopy(bp->data + off%BSIZE, src, m) < 0){
+      brelse(bp);
+      break;
+    }
     log_write(bp);
     brelse(bp);
   }
 
-  if(n > 0 && off > ip->size){
-    ip->size = off;
+  // After a failed copy too, since bmap() may have given ip a
+  // block, and the bytes before it are written.
+  if(off > ip->size || tot < n){
+    if(off > ip->size)
+      ip->size = off;
     iupdate(ip);
   }
-  return n;
+  if(tot < n && tot == 0)
+    return -1;
+  return tot;
 }
 
 //PAGEBREAK!
@@ -3,7 +3,12 @@
 
 
 #define ROOTINO 1  // root i-number
-#define BSIZE 512  // block size
+#ifndef BSIZE
+#define BSIZE 512  // block size; make BSIZE=1024, 2048 or 4096 for others
+#endif
+#if BSIZE < 512 || BSIZE > 4096 || (BSIZE & (BSIZE-1)) != 0
+#error "BSIZE must be 512, 1024, 2048 or 4096"
+#endif
 
 // Disk layout:
 // [ boot block | super block | log | inode blocks |
@@ -19,8 +24,14 @@ struct superblock {
   uint logstart;     // Block number of first log block
   uint inodestart;   // Block number of first inode block
   uint bmapstart;    // Block number of first free map block
+  uint swapstart;    // Block number of first swap block
+  uint nswap;        // Number of swap blocks
+  uint bsize;        // Block size in bytes (0 in older images: 512)
+  uint flags;        // FS_EXTENT if inodes map blocks by extents
 };
 
+#define FS_EXTENT 0x1
+
 #define NDIRECT 11   // FS - 1. reduce 1 for double indirect (to maintain same size of inode)
 #define NINDIRECT (BSIZE / sizeof(uint))
 
@@ -28,6 +39,7 @@ struct superblock {
 #define NDOUBLEINDIRECT (NINDIRECT * NINDIRECT) 
 
 #define MAXFILE (NDIRECT + NINDIRECT + NDOUBLEINDIRECT)
+#define EMAXFILE (0x7fffffff / BSIZE)  // extent format: as far as a size goes
 
 // On-disk inode structure
 struct dinode {
@@ -39,6 +51,19 @@ struct dinode {
   uint addrs[NDIRECT+1+1];   // Data block addresses
 };
 
+// In the extent format, addrs[] holds NEXTENT runs of
+// consecutive blocks, in file order, and then the address of a
+// block with NEXTENTB more runs.  The slot after those, entry
+// NEXTENTB, holds in its start the address of the next such
+// block, or 0, so a file can have any number of runs.
+struct extent {
+  uint start;  // first block of the run
+  uint len;    // blocks in the run; 0 ends the list
+};
+#define NEXTENT   ((NDIRECT+1+1-1) / 2)
+#define EXTBLOCK  (2*NEXTENT)  // addrs[] slot of the overflow block
+#define NEXTENTB  (BSIZE / sizeof(struct extent) - 1)
+
 // Inodes per block.
 #define IPB           (BSIZE / sizeof(struct dinode))
 
@@ -4,12 +4,33 @@
 #include "fs.h"
 #include "fcntl.h"
 
+uint intr0, xfer0, cyc0;
+int t0;
+
+// time and disk interrupts for the test just done.
+void
+report(char *what, int kb)
+{
+  uint intr, xfer, cyc;
+  int t;
+
+  idestat(&intr, &xfer, &cyc);
+  t = uptime() - t0;
+  xfer -= xfer0;
+  printf(1, "%s: %d KB in %d ticks, %d KB/s, %d disk interrupts for %d blocks, "
+         "%d driver cycles/MB\n", what, kb, t, kb * 100 / (t ? t : 1),
+         intr - intr0, xfer, xfer ? (cyc - cyc0) / xfer * (1024*1024/BSIZE) : 0);
+  idestat(&intr0, &xfer0, &cyc0);
+  t0 = uptime();
+}
+
 int
 main(int argc, char *argv[])
 {
   int fd, i, j; 
   int r;
   int total;
+  struct stat st;
   char *path = (argc > 1) ? argv[1] : "hugefile";
   char data[512];
   char buf[512];
@@ -21,6 +42,8 @@ main(int argc, char *argv[])
   }
 
   printf(1, "1. create test\n");
+  idestat(&intr0, &xfer0, &cyc0);
+  t0 = uptime();
   fd = open(path, O_CREATE | O_RDWR);
   for(i = 0; i < 1024; i++){
     if (i % 100 == 0){
@@ -34,6 +57,9 @@ main(int argc, char *argv[])
   }
   printf(1, "%d bytes written\n", 1024 * 512);
   close(fd);
+  report("create", 512);
+  if(stat(path, &st) >= 0)
+    printf(1, "%d KB file, %d block map blocks\n", st.size / 1024, st.nmeta);
 
   printf(1, "2. read test\n");
   fd = open(path, O_RDONLY);
@@ -54,6 +80,7 @@ main(int argc, char *argv[])
   }
   printf(1, "%d bytes read\n", 1024 * 512);
   close(fd);
+  report("read", 512);
 
   printf(1, "3. stress test\n");
   total = 0;
@@ -78,6 +105,7 @@ main(int argc, char *argv[])
       printf(1, "%d bytes written\n", total);
     close(fd);
   }
+  report("stress", total / 1024);
 
   exit();
 }
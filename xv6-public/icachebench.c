@@ -0,0 +1,105 @@
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "fcntl.h"
+
+// ls of a large directory, repeated, and processes opening and
+// closing its files in parallel.  The files stay in the inode
+// cache after they are created, so block lookups per pass are
+// mostly the directory's blocks and ls itself, not inode blocks.
+
+#define NFILE   120  // files in the directory
+#define NPASS   3
+#define NOPEN   500  // opens by each process
+#define NCHILD  4
+
+char path[16];
+
+void
+fpath(int i)
+{
+  strcpy(path, "idir/fxxx");
+  path[6] = '0' + i / 100;
+  path[7] = '0' + i / 10 % 10;
+  path[8] = '0' + i % 10;
+}
+
+// run "ls idir" with its output going to a file.
+void
+lspass(int pass)
+{
+  char *argv[] = { "ls", "idir", 0 };
+  uint hit0, miss0, hit, miss;
+  int t;
+
+  bstat(&hit0, &miss0);
+  t = uptime();
+  if(fork() == 0){
+    close(1);
+    if(open("lsout", O_CREATE | O_RDWR) != 1)
+      exit();
+    exec("ls", argv);
+    exit();
+  }
+  wait();
+  t = uptime() - t;
+  bstat(&hit, &miss);
+  printf(1, "ls pass %d: %d ticks, %d block lookups, %d misses\n",
+         pass, t, (hit + miss) - (hit0 + miss0), miss - miss0);
+  unlink("lsout");
+}
+
+void
+openclose(void)
+{
+  int i, j, fd, t;
+
+  t = uptime();
+  for(i = 0; i < NCHILD; i++){
+    if(fork() == 0){
+      for(j = 0; j < NOPEN; j++){
+        fpath((i * 37 + j) % NFILE);
+        if((fd = open(path, O_RDONLY)) < 0){
+          printf(1, "icachebench: cannot open %s\n", path);
+          exit();
+        }
+        close(fd);
+      }
+      exit();
+    }
+  }
+  for(i = 0; i < NCHILD; i++)
+    wait();
+  printf(1, "%d processes x %d open/close: %d ticks\n",
+         NCHILD, NOPEN, uptime() - t);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int i, fd;
+
+  printf(1, "icachebench starting\n");
+  if(mkdir("idir") < 0){
+    printf(1, "icachebench: mkdir idir failed\n");
+    exit();
+  }
+  for(i = 0; i < NFILE; i++){
+    fpath(i);
+    if((fd = open(path, O_CREATE | O_RDWR)) < 0){
+      printf(1, "icachebench: cannot create %s\n", path);
+      exit();
+    }
+    close(fd);
+  }
+  for(i = 0; i < NPASS; i++)
+    lspass(i);
+  openclose();
+  for(i = 0; i < NFILE; i++){
+    fpath(i);
+    unlink(path);
+  }
+  unlink("idir");
+  printf(1, "icachebench done\n");
+  exit();
+}
@@ -1,4 +1,5 @@
-// Simple PIO-based (non-DMA) IDE driver code.
+// Simple IDE driver code: bus master DMA when the PCI IDE
+// controller has it, PIO otherwise.
 
 #include "types.h"
 #include "defs.h"
@@ -12,6 +13,7 @@
 #include "sleeplock.h"
 #include "fs.h"
 #include "buf.h"
+#include "pci.h"
 
 #define SECTOR_SIZE   512
 #define IDE_BSY       0x80
@@ -23,16 +25,65 @@
 #define IDE_CMD_WRITE 0x30
 #define IDE_CMD_RDMUL 0xc4
 #define IDE_CMD_WRMUL 0xc5
+#define IDE_CMD_SETMUL 0xc6
+#define IDE_CMD_RDDMA 0xc8
+#define IDE_CMD_WRDMA 0xca
+
+#define IDE_MAXMUL    16    // sectors per READ/WRITE MULTIPLE interrupt
+#define IDE_MAXDMA    128   // sectors per DMA transfer
+#define IDE_DEADLINE  10    // ticks a queued request may be passed over
+
+// Bus master registers of the primary channel, from bmbase.
+#define BM_CMD        0
+#define BM_STATUS     2
+#define BM_PRDT       4
+#define BM_START      0x01
+#define BM_READ       0x08  // device to memory
+#define BM_ERR        0x02
+#define BM_INTR       0x04
+
+// Physical region descriptor: one piece of memory of a DMA
+// transfer.  The table must not cross a 64KB boundary, nor may
+// any piece.
+struct prd {
+  uint addr;
+  ushort len;
+  ushort flags;
+};
+#define PRD_EOT       0x8000  // last piece
 
 // idequeue points to the buf now being read/written to the disk.
-// idequeue->qnext points to the next buf to be processed.
+// idequeue->qnext points to the next buf to be processed, and
+// idetail to the last one.
 // You must hold idelock while manipulating queue.
+//
+// bio_submit() queues a request and returns; ideintr() starts the
+// next request and then runs the finished one's completion
+// handler.  iderw() is bio_submit() plus a wait.
+//
+// The queue is kept in one-way elevator order, and idestart()
+// moves a run of adjacent blocks with one command, so the first
+// idenactive bufs of the queue are in flight together.  Once a
+// request has waited IDE_DEADLINE ticks, new ones no longer go
+// ahead of it, so a reader streaming up the disk cannot starve
+// requests for low blocks, such as the log's.
 
 static struct spinlock idelock;
 static struct buf *idequeue;
+static struct buf *idetail;
+static int idenactive;
 
 static int havedisk1;
+static int idemul[2];  // sectors per PIO interrupt, 0 for one
+static uint nintr;     // interrupts so far, for idestat()
+static uint nxfer;     // bufs moved so far
+static uint ncycles;   // cycles spent in idestart() and ideintr()
+
+static ushort bmbase;     // bus master ports, 0 to use PIO
+static struct prd *prdt;  // in a page of its own
 static void idestart(struct buf*);
+static void idesetmul(int);
+static void idedmainit(void);
 
 // Wait for IDE disk to become ready.
 static int
@@ -66,103 +117,311 @@ ideinit(void)
     }
   }
 
+  // No interrupts until the first request.
+  outb(0x3f6, 2);
+  idesetmul(0);
+  if(havedisk1)
+    idesetmul(1);
+  idedmainit();
+
+  // PIO moves a block of several sectors with one interrupt
+  // only in multiple mode.
+  if(!bmbase && BSIZE > SECTOR_SIZE &&
+     (idemul[0] < BSIZE/SECTOR_SIZE ||
+      (havedisk1 && idemul[1] < BSIZE/SECTOR_SIZE)))
+    panic("ideinit: no multiple mode for BSIZE");
+
   // Switch back to disk 0.
   outb(0x1f6, 0xe0 | (0<<4));
 }
 
-// Start the request for b.  Caller must hold idelock.
+// Ask disk dev to move up to IDE_MAXMUL sectors per interrupt
+// with READ/WRITE MULTIPLE.  A disk that refuses gets one block
+// per command.
+static void
+idesetmul(int dev)
+{
+  outb(0x1f6, 0xe0 | (dev<<4));
+  idewait(0);
+  outb(0x1f2, IDE_MAXMUL);
+  outb(0x1f7, IDE_CMD_SETMUL);
+  if(idewait(1) >= 0)
+    idemul[dev] = IDE_MAXMUL;
+}
+
+// Use the PCI IDE controller's bus master DMA if there is one.
+static void
+idedmainit(void)
+{
+  struct pcidev d;
+
+  if(pcifind(PCI_ANY, PCI_ANY, 0x01, 0x01, &d) < 0 ||
+     !(d.bario & (1<<4)) || d.bar[4] == 0)
+    return;
+  if((prdt = (struct prd*)kalloc()) == 0)
+    return;
+  pcienable(&d);
+  bmbase = d.bar[4];
+  cprintf("ide: bus master DMA at 0x%x\n", bmbase);
+}
+
+// Describe the data of b and the n-1 bufs after it in prdt.
+static void
+ideprd(struct buf *b, int n)
+{
+  struct prd *p;
+  uint pa, len;
+  int i;
+
+  p = prdt;
+  for(i = 0; i < n; i++, b = b->qnext){
+    pa = V2P(b->data);
+    for(len = BSIZE; len > 0; len -= p->len, pa += p->len, p++){
+      p->addr = pa;
+      p->len = len;
+      if((pa & 0xffff) + len > 0x10000)
+        p->len = 0x10000 - (pa & 0xffff);
+      p->flags = 0;
+    }
+  }
+  p[-1].flags = PRD_EOT;
+}
+
+// Is b the block right after a on the disk, going the same way?
+static int
+ideadjacent(struct buf *a, struct buf *b)
+{
+  return a->dev == b->dev && a->blockno + 1 == b->blockno &&
+    (a->flags & B_DIRTY) == (b->flags & B_DIRTY);
+}
+
+// Where b lies on the elevator's sweep that starts at base.
+static uint
+idepos(struct buf *b, uint base)
+{
+  return ((b->dev << 28) | b->blockno) - base;
+}
+
+// Start the request for b, along with the queued bufs that
+// follow it on the disk.  Caller must hold idelock.
 static void
 idestart(struct buf *b)
 {
+  struct buf *q;
+  int i, n;
+  uint t;
+
   if(b == 0)
     panic("idestart");
-  if(b->blockno >= FSSIZE)
-    panic("incorrect blockno");
+  t = rdtsc();
   int sector_per_block =  BSIZE/SECTOR_SIZE;
   int sector = b->blockno * sector_per_block;
-  int read_cmd = (sector_per_block == 1) ? IDE_CMD_READ :  IDE_CMD_RDMUL;
-  int write_cmd = (sector_per_block == 1) ? IDE_CMD_WRITE : IDE_CMD_WRMUL;
+  int mul = bmbase ? IDE_MAXDMA : idemul[b->dev&1];
+  int read_cmd = (mul == 0) ? IDE_CMD_READ :  IDE_CMD_RDMUL;
+  int write_cmd = (mul == 0) ? IDE_CMD_WRITE : IDE_CMD_WRMUL;
 
-  if (sector_per_block > 7) panic("idestart");
+  n = 1;
+  for(q = b; q->qnext && ideadjacent(q, q->qnext); q = q->qnext){
+    if((n+1) * sector_per_block > mul)
+      break;
+    n++;
+  }
+  idenactive = n;
+
+  if(bmbase){
+    ideprd(b, n);
+    outl(bmbase+BM_PRDT, V2P(prdt));
+    outb(bmbase+BM_CMD, (b->flags & B_DIRTY) ? 0 : BM_READ);
+    outb(bmbase+BM_STATUS, inb(bmbase+BM_STATUS) | BM_ERR | BM_INTR);
+  }
 
   idewait(0);
   outb(0x3f6, 0);  // generate interrupt
-  outb(0x1f2, sector_per_block);  // number of sectors
+  outb(0x1f2, n * sector_per_block);  // number of sectors
   outb(0x1f3, sector & 0xff);
   outb(0x1f4, (sector >> 8) & 0xff);
   outb(0x1f5, (sector >> 16) & 0xff);
   outb(0x1f6, 0xe0 | ((b->dev&1)<<4) | ((sector>>24)&0x0f));
-  if(b->flags & B_DIRTY){
+  if(bmbase){
+    outb(0x1f7, (b->flags & B_DIRTY) ? IDE_CMD_WRDMA : IDE_CMD_RDDMA);
+    outb(bmbase+BM_CMD, inb(bmbase+BM_CMD) | BM_START);
+  } else if(b->flags & B_DIRTY){
     outb(0x1f7, write_cmd);
-    outsl(0x1f0, b->data, BSIZE/4);
+    for(q = b, i = 0; i < n; q = q->qnext, i++)
+      outsl(0x1f0, q->data, BSIZE/4);
   } else {
     outb(0x1f7, read_cmd);
   }
+  ncycles += rdtsc() - t;
 }
 
 // Interrupt handler.
 void
 ideintr(void)
 {
-  struct buf *b;
+  struct buf *b, *fin, **finp;
+  void (*done)(struct buf*);
+  int i, err;
+  uint t, st;
 
-  // First queued buffer is the active request.
+  // First idenactive queued buffers are the active request.
   acquire(&idelock);
-  if((b = idequeue) == 0){
+  if(idequeue == 0){
     release(&idelock);
     // cprintf("spurious IDE interrupt\n");
     return;
   }
-  idequeue = b->qnext;
+  t = rdtsc();
+  nintr++;
+  nxfer += idenactive;
 
-  // Read data if needed.
-  if(!(b->flags & B_DIRTY) && idewait(1) >= 0)
-    insl(0x1f0, b->data, BSIZE/4);
+  err = 0;
+  if(bmbase){
+    outb(bmbase+BM_CMD, 0);
+    st = inb(bmbase+BM_STATUS);
+    outb(bmbase+BM_STATUS, st | BM_ERR | BM_INTR);
+    if(idewait(1) < 0 || (st & BM_ERR))
+      err = -1;
+  } else if(!(idequeue->flags & B_DIRTY))
+    err = idewait(1);
+  fin = 0;
+  finp = &fin;
+  for(i = 0; i < idenactive; i++){
+    b = idequeue;
+    idequeue = b->qnext;
 
-  // Wake process waiting for this buf.
-  b->flags |= B_VALID;
-  b->flags &= ~B_DIRTY;
-  wakeup(b);
+    // Read data if needed.
+    if(!(b->flags & B_DIRTY) && err >= 0 && !bmbase)
+      insl(0x1f0, b->data, BSIZE/4);
+
+    // Wake process waiting for this buf,
+    // or save it for its handler.
+    b->flags |= B_VALID;
+    b->flags &= ~B_DIRTY;
+    if(b->done){
+      b->qnext = 0;
+      *finp = b;
+      finp = &b->qnext;
+    } else
+      wakeup(b);
+  }
+  idenactive = 0;
+  if(idequeue == 0)
+    idetail = 0;
 
   // Start disk on next buf in queue.
   if(idequeue != 0)
     idestart(idequeue);
+  ncycles += rdtsc() - t;
 
   release(&idelock);
+
+  // The handlers may submit more requests.
+  while((b = fin) != 0){
+    fin = b->qnext;
+    done = b->done;
+    b->done = 0;
+    done(b);
+  }
 }
 
 //PAGEBREAK!
-// Sync buf with disk.
+// Start syncing buf with disk, without waiting.
 // If B_DIRTY is set, write buf to disk, clear B_DIRTY, set B_VALID.
 // Else if B_VALID is not set, read buf from disk, set B_VALID.
+// Then done(b) runs from ideintr(), with b still locked.
+// Without a done function, a process must wait in iderw().
+// Disk 1 is the virtio disk when there is one.
 void
-iderw(struct buf *b)
+bio_submit(struct buf *b, void (*done)(struct buf*))
 {
-  struct buf **pp;
+  struct buf **pp, *q;
+  uint base;
+  int i;
 
+  if(b->dev == 1 && havevirtio){
+    virtio_submit(b, done);
+    return;
+  }
   if(!holdingsleep(&b->lock))
-    panic("iderw: buf not locked");
+    panic("bio_submit: buf not locked");
   if((b->flags & (B_VALID|B_DIRTY)) == B_VALID)
-    panic("iderw: nothing to do");
+    panic("bio_submit: nothing to do");
   if(b->dev != 0 && !havedisk1)
-    panic("iderw: ide disk 1 not present");
+    panic("bio_submit: ide disk 1 not present");
+  if(b->blockno >= FSSIZE + SWAPSIZE)  // swap follows the file system
+    panic("incorrect blockno");
 
   acquire(&idelock);  //DOC:acquire-lock
 
-  // Append b to idequeue.
   b->qnext = 0;
-  for(pp=&idequeue; *pp; pp=&(*pp)->qnext)  //DOC:insert-queue
-    ;
+  b->done = done;
+  b->qtime = ticks;
+  if(idequeue == 0){
+    idequeue = idetail = b;
+    idestart(b);
+    release(&idelock);
+    return;
+  }
+
+  // Insert b in elevator order: up the disk from where the
+  // transfer in progress ends, then around from block 0.  Adjacent
+  // blocks end up next to each other, ready for idestart() to
+  // merge.  Most requests go at the tail.
+  pp = &idequeue;
+  q = idequeue;
+  for(i = 0; i < idenactive; i++){
+    q = *pp;
+    pp = &q->qnext;
+  }
+  base = (q->dev << 28) | q->blockno;
+  if(idepos(b, base) >= idepos(idetail, base))
+    pp = &idetail->qnext;
+  else {
+    while(*pp && idepos(*pp, base) <= idepos(b, base))  //DOC:insert-queue
+      pp = &(*pp)->qnext;
+    for(q = *pp; q; q = q->qnext){
+      if(ticks - q->qtime >= IDE_DEADLINE){  // overdue: b waits its turn
+        pp = &idetail->qnext;
+        break;
+      }
+    }
+  }
+  b->qnext = *pp;
   *pp = b;
+  if(b->qnext == 0)
+    idetail = b;
 
-  // Start disk if necessary.
-  if(idequeue == b)
-    idestart(b);
+  release(&idelock);
+}
+
+// Sync buf with disk and wait for it.
+void
+iderw(struct buf *b)
+{
+  if(b->dev == 1 && havevirtio){
+    virtiorw(b);
+    return;
+  }
+  bio_submit(b, 0);
 
   // Wait for request to finish.
+  acquire(&idelock);
   while((b->flags & (B_VALID|B_DIRTY)) != B_VALID){
     sleep(b, &idelock);
   }
 
   release(&idelock);
 }
+
+// Disk interrupts, bufs moved, and cycles spent driving the
+// disk so far.
+void
+idestat(uint *intr, uint *xfer, uint *cycles)
+{
+  acquire(&idelock);
+  *intr = nintr;
+  *xfer = nxfer;
+  *cycles = ncycles;
+  release(&idelock);
+}
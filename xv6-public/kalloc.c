@@ -1,6 +1,12 @@
 // Physical memory allocator, intended to allocate
 // memory for user processes, kernel stacks, page table pages,
 // and pipe buffers. Allocates 4096-byte pages.
+// It also keeps up to NSUPERPAGE 4MB-aligned chunks aside for
+// 4MB user pages (see allocuvm); when the 4096-byte pages run
+// out, one of those chunks is broken up into ordinary pages.
+// A 4096-byte page can be mapped by several page tables (shared
+// mmap() regions); kref() counts the extra users and kfree()
+// only frees the page when the last one lets go.
 
 #include "types.h"
 #include "defs.h"
@@ -10,6 +16,7 @@
 #include "spinlock.h"
 
 void freerange(void *vstart, void *vend);
+static void splitsuper(void);
 extern char end[]; // first address after kernel loaded from ELF file
 
 struct run {
@@ -20,6 +27,8 @@ struct {
   struct spinlock lock;
   int use_lock;
   struct run *freelist;
+  struct run *superlist;  // free 4MB superpages
+  ushort ref[PHYSTOP/PGSIZE];  // users of each allocated page
 } kmem;
 
 // Initialization happens in two phases.
@@ -38,7 +47,21 @@ kinit1(void *vstart, void *vend)
 void
 kinit2(void *vstart, void *vend)
 {
-  freerange(vstart, vend);
+  struct run *r;
+  char *p;
+  int n;
+
+  // Set the highest 4MB-aligned chunks aside as superpages.
+  p = (char*)SPGROUNDDOWN((uint)vend);
+  for(n = 0; n < NSUPERPAGE && p - SPGSIZE >= (char*)vstart; n++){
+    p -= SPGSIZE;
+    r = (struct run*)p;
+    r->next = kmem.superlist;
+    kmem.superlist = r;
+  }
+  freerange(vstart, n > 0 ? p : vend);
+  if(n > 0)
+    freerange(p + n*SPGSIZE, vend);
   kmem.use_lock = 1;
 }
 
@@ -64,6 +87,19 @@ kfree(char *v)
   if((uint)v % PGSIZE || v < end || V2P(v) >= PHYSTOP)
     panic("kfree");
 
+  if(kmem.use_lock)
+    acquire(&kmem.lock);
+  if(kmem.ref[V2P(v)/PGSIZE] > 1){
+    // someone else still maps it.
+    kmem.ref[V2P(v)/PGSIZE]--;
+    if(kmem.use_lock)
+      release(&kmem.lock);
+    return;
+  }
+  kmem.ref[V2P(v)/PGSIZE] = 0;
+  if(kmem.use_lock)
+    release(&kmem.lock);
+
   // Fill with junk to catch dangling refs.
   memset(v, 1, PGSIZE);
 
@@ -86,11 +122,104 @@ kalloc(void)
 
   if(kmem.use_lock)
     acquire(&kmem.lock);
+  if(kmem.freelist == 0 && kmem.superlist != 0)
+    splitsuper();
   r = kmem.freelist;
-  if(r)
+  if(r){
     kmem.freelist = r->next;
+    kmem.ref[V2P(r)/PGSIZE] = 1;
+  }
   if(kmem.use_lock)
     release(&kmem.lock);
   return (char*)r;
 }
 
+// Add a user to a page returned by kalloc(); it then takes
+// one more kfree() to free it.
+void
+kref(char *v)
+{
+  if((uint)v % PGSIZE || v < end || V2P(v) >= PHYSTOP)
+    panic("kref");
+  acquire(&kmem.lock);
+  if(kmem.ref[V2P(v)/PGSIZE] == 0)
+    panic("kref: free page");
+  kmem.ref[V2P(v)/PGSIZE]++;
+  release(&kmem.lock);
+}
+
+// Number of users of a page returned by kalloc().
+int
+krefcount(char *v)
+{
+  int n;
+
+  acquire(&kmem.lock);
+  n = kmem.ref[V2P(v)/PGSIZE];
+  release(&kmem.lock);
+  return n;
+}
+
+// Break a free superpage up into 4096-byte pages.
+// Caller must hold kmem.lock.
+static void
+splitsuper(void)
+{
+  struct run *r;
+  char *p;
+
+  p = (char*)kmem.superlist;
+  kmem.superlist = kmem.superlist->next;
+  for(r = (struct run*)(p + SPGSIZE - PGSIZE); (char*)r >= p; r = (struct run*)((char*)r - PGSIZE)){
+    r->next = kmem.freelist;
+    kmem.freelist = r;
+  }
+}
+
+// Allocate one 4MB-aligned superpage of physical memory.
+// Returns 0 if none is left; callers fall back to 4096-byte pages.
+char*
+ksuperalloc(void)
+{
+  struct run *r;
+
+  acquire(&kmem.lock);
+  r = kmem.superlist;
+  if(r)
+    kmem.superlist = r->next;
+  release(&kmem.lock);
+  return (char*)r;
+}
+
+// Free a superpage returned by ksuperalloc().
+void
+ksuperfree(char *v)
+{
+  struct run *r;
+
+  if((uint)v % SPGSIZE || v < end || V2P(v) + SPGSIZE > PHYSTOP)
+    panic("ksuperfree");
+
+  acquire(&kmem.lock);
+  r = (struct run*)v;
+  r->next = kmem.superlist;
+  kmem.superlist = r;
+  release(&kmem.lock);
+}
+
+// Count free memory in 4096-byte pages, superpages included.
+int
+kfreepages(void)
+{
+  struct run *r;
+  int n;
+
+  n = 0;
+  acquire(&kmem.lock);
+  for(r = kmem.freelist; r; r = r->next)
+    n++;
+  for(r = kmem.superlist; r; r = r->next)
+    n += SPGSIZE / PGSIZE;
+  release(&kmem.lock);
+  return n;
+}
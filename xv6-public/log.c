@@ -27,7 +27,8 @@
 //   block B
 //   block C
 //   ...
-// Log appends are synchronous.
+// The writes of a commit are queued together with bio_submit()
+// and waited for as a group, so the disk never sits idle between them.
 
 // Contents of the header block, used for both the on-disk header block
 // and to keep track in memory of logged block# before commit.
@@ -43,6 +44,7 @@ struct log {
   int outstanding; // how many FS sys calls are executing.
   int committing;  // in commit(), please wait.
   int dev;
+  int nio;         // writes queued by logwrite() and not done
   struct logheader lh;
 };
 struct log log;
@@ -65,20 +67,54 @@ initlog(int dev)
   recover_from_log();
 }
 
+// Runs from ideintr() as each logwrite() finishes.
+static void
+logwritten(struct buf *b)
+{
+  acquire(&log.lock);
+  if(--log.nio == 0)
+    wakeup(&log.nio);
+  release(&log.lock);
+}
+
+// Queue a write of locked buffer b without waiting for it.
+static void
+logwrite(struct buf *b)
+{
+  b->flags |= B_DIRTY;
+  acquire(&log.lock);
+  log.nio++;
+  release(&log.lock);
+  bio_submit(b, logwritten);
+}
+
+// Wait for all queued logwrite()s to finish.
+static void
+logwait(void)
+{
+  acquire(&log.lock);
+  while(log.nio > 0)
+    sleep(&log.nio, &log.lock);
+  release(&log.lock);
+}
+
 // Copy committed blocks from log to their home location
 static void
 install_trans(void)
 {
+  struct buf *dbuf[LOGSIZE];
   int tail;
 
   for (tail = 0; tail < log.lh.n; tail++) {
     struct buf *lbuf = bread(log.dev, log.start+tail+1); // read log block
-    struct buf *dbuf = bread(log.dev, log.lh.block[tail]); // read dst
-    memmove(dbuf->data, lbuf->data, BSIZE);  // copy block to dst
-    bwrite(dbuf);  // write dst to disk
+    dbuf[tail] = bread(log.dev, log.lh.block[tail]); // read dst
+    memmove(dbuf[tail]->data, lbuf->data, BSIZE);  // copy block to dst
     brelse(lbuf);
-    brelse(dbuf);
+    logwrite(dbuf[tail]);  // write dst to disk
   }
+  logwait();
+  for (tail = 0; tail < log.lh.n; tail++)
+    brelse(dbuf[tail]);
 }
 
 // Read the log header from disk into the in-memory log header
@@ -175,16 +211,19 @@ end_op(void)
 static void
 write_log(void)
 {
+  struct buf *to[LOGSIZE];
   int tail;
 
   for (tail = 0; tail < log.lh.n; tail++) {
-    struct buf *to = bread(log.dev, log.start+tail+1); // log block
+    to[tail] = bread(log.dev, log.start+tail+1); // log block
     struct buf *from = bread(log.dev, log.lh.block[tail]); // cache block
-    memmove(to->data, from->data, BSIZE);
-    bwrite(to);  // write the log
+    memmove(to[tail]->data, from->data, BSIZE);
     brelse(from);
-    brelse(to);
+    logwrite(to[tail]);  // write the log
   }
+  logwait();
+  for (tail = 0; tail < log.lh.n; tail++)
+    brelse(to[tail]);
 }
 
 static void
@@ -7,6 +7,9 @@
 #include "x86.h"
 
 static void startothers(void);
+#if MEMTEST == TRUE
+static void memtest(void);
+#endif
 static void mpmain(void)  __attribute__((noreturn));
 extern pde_t *kpgdir;
 extern char end[]; // first address after kernel loaded from ELF file
@@ -31,7 +34,15 @@ main(void)
   tvinit();        // trap vectors
   binit();         // buffer cache
   fileinit();      // file table
+  icacheinit();    // inode cache
+  pipeinit();      // pipe cache
+  mmapinit();      // mmap regions
+  pcacheinit();    // page cache
+#if MEMTEST == TRUE
+  memtest();       // check and time memmove() and friends
+#endif
   ideinit();       // disk
+  virtioinit();    // virtio disk, if any
   if(!ismp)
     timerinit();   // uniprocessor timer
   startothers();   // start other processors
@@ -63,6 +74,71 @@ mpmain(void)
   scheduler();     // start running processes
 }
 
+#if MEMTEST == TRUE
+// Check memmove, memset and memcmp on overlapping and unaligned
+// buffers, then print what each costs per KB.  A debugging aid
+// for the kernel's string.c; membench covers ulib's copies.
+static void
+memtest(void)
+{
+  char *a, *b;
+  uint t, mv, mvu, mvb, ms, mc;
+  int i;
+
+  if((a = kalloc()) == 0 || (b = kalloc()) == 0)
+    panic("memtest: kalloc");
+  for(i = 0; i < PGSIZE; i++)
+    a[i] = i % 251;
+  memmove(b, a, PGSIZE);
+  if(memcmp(a, b, PGSIZE) != 0)
+    panic("memtest copy");
+  memmove(b + 1, b, PGSIZE - 1);
+  for(i = 0; i < PGSIZE - 1; i++)
+    if(b[i+1] != a[i])
+      panic("memtest backward");
+  memmove(b, a, PGSIZE);
+  memmove(b, b + 3, PGSIZE - 3);
+  for(i = 0; i < PGSIZE - 3; i++)
+    if(b[i] != a[i+3])
+      panic("memtest forward");
+  memmove(b, a, PGSIZE);
+  b[2001]++;
+  if(memcmp(a, b, PGSIZE) >= 0 || memcmp(b, a, PGSIZE) <= 0)
+    panic("memtest memcmp");
+  memset(b + 1, 7, 13);
+  for(i = 0; i < 15; i++)
+    if(b[i] != (i >= 1 && i < 14 ? 7 : a[i]))
+      panic("memtest memset");
+
+  // 16 rounds of a page is 64KB.
+  t = rdtsc();
+  for(i = 0; i < 16; i++)
+    memmove(b, a, PGSIZE);
+  mv = (rdtsc() - t) / 64;
+  t = rdtsc();
+  for(i = 0; i < 16; i++)
+    memmove(b + 1, a, PGSIZE - 1);
+  mvu = (rdtsc() - t) / 64;
+  t = rdtsc();
+  for(i = 0; i < 16; i++)
+    memmove(b + 1, b, PGSIZE - 1);
+  mvb = (rdtsc() - t) / 64;
+  t = rdtsc();
+  for(i = 0; i < 16; i++)
+    memset(b, 0, PGSIZE);
+  ms = (rdtsc() - t) / 64;
+  memmove(b, a, PGSIZE);
+  t = rdtsc();
+  for(i = 0; i < 16; i++)
+    memcmp(a, b, PGSIZE);
+  mc = (rdtsc() - t) / 64;
+  cprintf("mem: cycles/KB memmove %d, unaligned %d, backward %d, "
+          "memset %d, memcmp %d\n", mv, mvu, mvb, ms, mc);
+  kfree(a);
+  kfree(b);
+}
+#endif
+
 pde_t entrypgdir[];  // For entry.S
 
 // Start the non-boot (AP) processors.
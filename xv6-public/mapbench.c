@@ -0,0 +1,74 @@
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "fcntl.h"
+#include "fs.h"
+
+// Random and sequential 512-byte reads of a large file, with the
+// block cache lookups they cost.  One lookup per read is the data
+// block alone; more means trips through the block map.
+// The default file fits the 512-byte-block file system; on a
+// BSIZE=4096 build, "mapbench 8192" reads an 8MB file.
+
+#define NREAD 2000
+
+char buf[512];
+
+void
+report(char *what, int n, int t, uint hit0, uint miss0)
+{
+  uint hit, miss;
+
+  bstat(&hit, &miss);
+  hit -= hit0;
+  miss -= miss0;
+  printf(1, "%s: %d reads in %d ticks, %d block lookups (%d misses), "
+         "%d.%d per read\n", what, n, t, hit + miss, miss,
+         (hit + miss) / n, (hit + miss) * 10 / n % 10);
+}
+
+int
+main(int argc, char *argv[])
+{
+  uint hit0, miss0, seed, off;
+  int fd, i, kb, n, t;
+
+  kb = argc > 1 ? atoi(argv[1]) : 1024;
+  printf(1, "mapbench: %d KB file, block size %d\n", kb, BSIZE);
+  if((fd = open("mapfile", O_CREATE | O_RDWR)) < 0){
+    printf(1, "mapbench: cannot create mapfile\n");
+    exit();
+  }
+  for(n = 0; n < kb * 1024; n += sizeof(buf)){
+    ((int*)buf)[0] = n;
+    if(write(fd, buf, sizeof(buf)) != sizeof(buf)){
+      printf(1, "mapbench: write failed at %d\n", n);
+      exit();
+    }
+  }
+  close(fd);
+
+  fd = open("mapfile", O_RDONLY);
+  bstat(&hit0, &miss0);
+  t = uptime();
+  for(n = 0; read(fd, buf, sizeof(buf)) == sizeof(buf); n++)
+    ;
+  report("sequential", n, uptime() - t, hit0, miss0);
+
+  seed = 1;
+  bstat(&hit0, &miss0);
+  t = uptime();
+  for(i = 0; i < NREAD; i++){
+    seed = seed * 1103515245 + 12345;
+    off = (seed >> 8) % (kb * 2) * sizeof(buf);
+    if(lseek(fd, off, SEEK_SET) < 0 ||
+       read(fd, buf, sizeof(buf)) != sizeof(buf) || ((int*)buf)[0] != off){
+      printf(1, "mapbench: bad read at %d\n", off);
+      exit();
+    }
+  }
+  report("random", NREAD, uptime() - t, hit0, miss0);
+  close(fd);
+  unlink("mapfile");
+  exit();
+}
@@ -0,0 +1,94 @@
+// memmove, memset and memcmp, linked into both the kernel and
+// user programs (ULIB).
+//
+// Bulk work is done a word at a time: rep movsl and rep stosl once
+// the destination is word aligned, with rep movsb/stosb for the
+// ragged ends, and 4-byte compares in memcmp.  A move onto an
+// overlapping higher address copies backward, from the end.
+
+#include "types.h"
+#include "x86.h"
+
+void*
+memmove(void *dst, const void *src, uint n)
+{
+  const char *s;
+  char *d;
+  uint k;
+
+  s = src;
+  d = dst;
+  if(s < d && s + n > d){
+    // Backward: the tail up to an aligned end, then whole words,
+    // then the head.
+    s += n;
+    d += n;
+    k = (uint)d % 4;
+    if(k > n)
+      k = n;
+    movsbback(d - 1, s - 1, k);
+    s -= k;
+    d -= k;
+    n -= k;
+    movslback(d - 4, s - 4, n / 4);
+    s -= n & ~3;
+    d -= n & ~3;
+    movsbback(d - 1, s - 1, n % 4);
+  } else {
+    k = -(uint)d % 4;
+    if(k > n)
+      k = n;
+    movsb(d, s, k);
+    s += k;
+    d += k;
+    n -= k;
+    movsl(d, s, n / 4);
+    movsb(d + (n & ~3), s + (n & ~3), n % 4);
+  }
+  return dst;
+}
+
+// memcpy exists to placate GCC.  Use memmove.
+void*
+memcpy(void *dst, const void *src, uint n)
+{
+  return memmove(dst, src, n);
+}
+
+void*
+memset(void *dst, int c, uint n)
+{
+  char *d;
+  uint k;
+
+  d = dst;
+  c &= 0xFF;
+  k = -(uint)d % 4;
+  if(k > n)
+    k = n;
+  stosb(d, c, k);
+  d += k;
+  n -= k;
+  stosl(d, (c<<24)|(c<<16)|(c<<8)|c, n / 4);
+  stosb(d + (n & ~3), c, n % 4);
+  return dst;
+}
+
+int
+memcmp(const void *v1, const void *v2, uint n)
+{
+  const uchar *s1, *s2;
+
+  s1 = v1;
+  s2 = v2;
+  // Skip equal words; x86 allows unaligned loads.
+  for(; n >= 4 && *(uint*)s1 == *(uint*)s2; n -= 4)
+    s1 += 4, s2 += 4;
+  while(n-- > 0){
+    if(*s1 != *s2)
+      return *s1 - *s2;
+    s1++, s2++;
+  }
+
+  return 0;
+}
@@ -0,0 +1,112 @@
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "x86.h"
+
+#define BUFSIZE (64*1024)
+#define NROUND  32
+
+char a[BUFSIZE+8], b[BUFSIZE+8];
+
+// what memmove used to be: one byte per iteration.
+void
+bytemove(char *d, char *s, int n)
+{
+  while(n-- > 0)
+    *d++ = *s++;
+}
+
+int
+bytecmp(uchar *s1, uchar *s2, int n)
+{
+  while(n-- > 0){
+    if(*s1 != *s2)
+      return *s1 - *s2;
+    s1++, s2++;
+  }
+  return 0;
+}
+
+// print cycles per KB for NROUND runs over n bytes since t.
+void
+report(char *what, int n, uint t)
+{
+  printf(1, "%s, %d bytes: %d cycles/KB\n", what, n,
+         (rdtsc() - t) / (NROUND * n / 1024));
+}
+
+void
+bench(int n)
+{
+  uint t;
+  int i;
+
+  t = rdtsc();
+  for(i = 0; i < NROUND; i++)
+    bytemove(b, a, n);
+  report("byte loop", n, t);
+  t = rdtsc();
+  for(i = 0; i < NROUND; i++)
+    memmove(b, a, n);
+  report("memmove", n, t);
+  t = rdtsc();
+  for(i = 0; i < NROUND; i++)
+    memmove(b + 1, a + 2, n);
+  report("memmove unaligned", n, t);
+  t = rdtsc();
+  for(i = 0; i < NROUND; i++)
+    memmove(b + 3, b, n);
+  report("memmove backward", n, t);
+  t = rdtsc();
+  for(i = 0; i < NROUND; i++)
+    memset(b, i, n);
+  report("memset", n, t);
+  memmove(b, a, n);
+  t = rdtsc();
+  for(i = 0; i < NROUND; i++)
+    bytecmp((uchar*)a, (uchar*)b, n);
+  report("byte compare", n, t);
+  t = rdtsc();
+  for(i = 0; i < NROUND; i++)
+    memcmp(a, b, n);
+  report("memcmp", n, t);
+}
+
+// overlapping and unaligned moves against the byte loop.
+void
+check(void)
+{
+  char tmp[80];
+  int i, off, n;
+
+  for(off = 0; off < 8; off++){
+    for(n = 0; n < 70; n++){
+      for(i = 0; i < 80; i++)
+        a[i] = b[i] = i;
+      memmove(a + off, a + 3, n);
+      bytemove(tmp, b + 3, n);  // through tmp, so overlap is right
+      bytemove(b + off, tmp, n);
+      if(memcmp(a, b, 80) != 0){
+        printf(1, "membench: memmove(%d, 3, %d) wrong\n", off, n);
+        exit();
+      }
+    }
+  }
+  printf(1, "memmove checks ok\n");
+}
+
+int
+main(int argc, char *argv[])
+{
+  int i;
+
+  printf(1, "membench starting\n");
+  check();
+  for(i = 0; i < BUFSIZE; i++)
+    a[i] = i % 251;
+  bench(64);
+  bench(4096);
+  bench(BUFSIZE);
+  printf(1, "membench done\n");
+  exit();
+}
@@ -31,6 +31,7 @@ struct superblock sb;
 char zeroes[BSIZE];
 uint freeinode = 1;
 uint freeblock;
+int extents = 1;  // extent-format inodes; -b for the old block map
 
 
 void balloc(int);
@@ -76,8 +77,13 @@ main(int argc, char *argv[])
 
   static_assert(sizeof(int) == 4, "Integers must be 4 bytes!");
 
+  if(argc > 1 && strcmp(argv[1], "-b") == 0){
+    extents = 0;
+    argc--;
+    argv++;
+  }
   if(argc < 2){
-    fprintf(stderr, "Usage: mkfs fs.img files...\n");
+    fprintf(stderr, "Usage: mkfs [-b] fs.img files...\n");
     exit(1);
   }
 
@@ -101,13 +107,17 @@ main(int argc, char *argv[])
   sb.logstart = xint(2);
   sb.inodestart = xint(2+nlog);
   sb.bmapstart = xint(2+nlog+ninodeblocks);
+  sb.swapstart = xint(FSSIZE);
+  sb.nswap = xint(SWAPSIZE);
+  sb.bsize = xint(BSIZE);
+  sb.flags = xint(extents ? FS_EXTENT : 0);
 
   printf("nmeta %d (boot, super, log blocks %u inode blocks %u, bitmap blocks %u) blocks %d total %d\n",
          nmeta, nlog, ninodeblocks, nbitmap, nblocks, FSSIZE);
 
   freeblock = nmeta;     // the first free block that we can allocate
 
-  for(i = 0; i < FSSIZE; i++)
+  for(i = 0; i < FSSIZE + SWAPSIZE; i++)
     wsect(i, zeroes);
 
   memset(buf, 0, sizeof(buf));
@@ -252,11 +262,39 @@ balloc(int used)
 
 #define min(a, b) ((a) < (b) ? (a) : (b))
 
+// Block fbn of an extent-format inode, taking the next free
+// block if fbn is just past the end.  mkfs writes one file at a
+// time, so most files are a single run; only the root directory
+// is interleaved with the files it lists.
+uint
+emap(struct dinode *din, uint fbn)
+{
+  struct extent *e;
+  uint i, off;
+
+  e = (struct extent*)din->addrs;
+  off = 0;
+  for(i = 0; i < NEXTENT && xint(e[i].len) != 0; i++){
+    if(fbn < off + xint(e[i].len))
+      return xint(e[i].start) + fbn - off;
+    off += xint(e[i].len);
+  }
+  assert(fbn == off);
+  if(i > 0 && xint(e[i-1].start) + xint(e[i-1].len) == freeblock)
+    e[i-1].len = xint(xint(e[i-1].len) + 1);
+  else {
+    assert(i < NEXTENT);
+    e[i].start = xint(freeblock);
+    e[i].len = xint(1);
+  }
+  return freeblock++;
+}
+
 void
 iappend(uint inum, void *xp, int n)
 {
   char *p = (char*)xp;
-  uint fbn, off, n1;
+  uint fbn, bn, off, n1;
   struct dinode din;
   char buf[BSIZE];
   uint indirect[NINDIRECT];
@@ -268,12 +306,14 @@ iappend(uint inum, void *xp, int n)
   while(n > 0){
     fbn = off / BSIZE;
     assert(fbn < MAXFILE);
-    if(fbn < NDIRECT){
+    if(extents){
+      x = emap(&din, fbn);
+    } else if(fbn < NDIRECT){
       if(xint(din.addrs[fbn]) == 0){
         din.addrs[fbn] = xint(freeblock++);
       }
       x = xint(din.addrs[fbn]);
-    } else {
+    } else if(fbn < NDIRECT + NINDIRECT){
       if(xint(din.addrs[NDIRECT]) == 0){
         din.addrs[NDIRECT] = xint(freeblock++);
       }
@@ -283,6 +323,24 @@ iappend(uint inum, void *xp, int n)
         wsect(xint(din.addrs[NDIRECT]), (char*)indirect);
       }
       x = xint(indirect[fbn-NDIRECT]);
+    } else {
+      // double indirect, laid out as in bmap()
+      bn = fbn - NDIRECT - NINDIRECT;
+      if(xint(din.addrs[NDIRECT+1]) == 0){
+        din.addrs[NDIRECT+1] = xint(freeblock++);
+      }
+      rsect(xint(din.addrs[NDIRECT+1]), (char*)indirect);
+      if(indirect[bn / NINDIRECT] == 0){
+        indirect[bn / NINDIRECT] = xint(freeblock++);
+        wsect(xint(din.addrs[NDIRECT+1]), (char*)indirect);
+      }
+      x = xint(indirect[bn / NINDIRECT]);
+      rsect(x, (char*)indirect);
+      if(indirect[bn % NINDIRECT] == 0){
+        indirect[bn % NINDIRECT] = xint(freeblock++);
+        wsect(x, (char*)indirect);
+      }
+      x = xint(indirect[bn % NINDIRECT]);
     }
     n1 = min(n, (fbn + 1) * BSIZE - off);
     rsect(x, buf);
@@ -0,0 +1,682 @@
+// Memory-mapped files and anonymous memory: mmap(), munmap(), msync().
+//
+// mmap() only records a region (struct vma) in the process PCB;
+// the LWPs of a process share its regions (see vmaproc).  Pages
+// are filled in by pagefault() on first touch: zeroes for
+// anonymous regions, file contents read with readi() otherwise.
+//
+// MAP_SHARED pages stay shared with children after fork(), and
+// dirty ones are written back to the file by msync() and munmap().
+// MAP_PRIVATE pages are copied on fork() and never written back;
+// whole pages of a private file region are first mapped read-only
+// from the page cache (pcache.c) and copied on the first write.
+//
+// exec() maps a program's segments as private file regions too
+// (see vmaexec), so programs are paged in as they run.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "memlayout.h"
+#include "mmu.h"
+#include "proc.h"
+#include "stat.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "fs.h"
+#include "file.h"
+#include "mman.h"
+
+// mm.lock protects every process's vma[].  busy counts the
+// pagefault()s reading a region's file without holding the lock;
+// a region's inode is not put until they are done.
+static struct {
+  struct spinlock lock;
+  int busy;
+} mm;
+
+void
+mmapinit(void)
+{
+  initlock(&mm.lock, "mmap");
+}
+
+// The PCB holding the regions of the running process: the
+// process itself, or the process an LWP belongs to.
+static struct proc*
+vmaproc(void)
+{
+  return proc->threadof ? proc->threadof : proc;
+}
+
+// Find the region of p holding va.  Caller must hold mm.lock.
+static struct vma*
+findvma(struct proc *p, uint va)
+{
+  struct vma *v;
+
+  for(v = p->vma; v < &p->vma[NVMA]; v++)
+    if(v->start <= va && va < v->end)
+      return v;
+  return 0;
+}
+
+// Find a region of p overlapping [start, end).
+// Caller must hold mm.lock.
+static struct vma*
+overlapvma(struct proc *p, uint start, uint end)
+{
+  struct vma *v;
+
+  for(v = p->vma; v < &p->vma[NVMA]; v++)
+    if(v->end != 0 && v->start < end && start < v->end)
+      return v;
+  return 0;
+}
+
+// Find len free bytes of address space in [MMAPBASE, MMAPTOP),
+// at addr if that is free.  Returns 0 if there is no room.
+// Caller must hold mm.lock.
+static uint
+vmaspace(struct proc *p, uint addr, uint len)
+{
+  struct vma *v;
+  uint a;
+
+  if(addr >= MMAPBASE && addr % PGSIZE == 0 && addr + len <= MMAPTOP &&
+     overlapvma(p, addr, addr + len) == 0)
+    return addr;
+  for(a = MMAPBASE; a + len <= MMAPTOP; a = v->end)
+    if((v = overlapvma(p, a, a + len)) == 0)
+      return a;
+  return 0;
+}
+
+// Map len bytes of f starting at file offset off, or zeroes with
+// MAP_ANONYMOUS, into the current process.  addr is only a hint.
+// Returns the address of the new region, or -1.
+int
+mmap(uint addr, uint len, int prot, int flags, struct file *f, uint off)
+{
+  struct proc *p;
+  struct vma *v;
+  uint a;
+
+  if(len == 0 || len > MMAPTOP - MMAPBASE || off % PGSIZE != 0)
+    return -1;
+  if(((flags & MAP_SHARED) != 0) == ((flags & MAP_PRIVATE) != 0))
+    return -1;
+  len = PGROUNDUP(len);
+  if(!(flags & MAP_ANONYMOUS)){
+    if(f == 0 || f->type != FD_INODE || !f->readable)
+      return -1;
+    if((flags & MAP_SHARED) && (prot & PROT_WRITE) && !f->writable)
+      return -1;
+    ilock(f->ip);
+    if(f->ip->type != T_FILE){
+      iunlock(f->ip);
+      return -1;
+    }
+    iunlock(f->ip);
+  }
+
+  p = vmaproc();
+  acquire(&mm.lock);
+  for(v = p->vma; v < &p->vma[NVMA]; v++)
+    if(v->end == 0)
+      break;
+  if(v == &p->vma[NVMA] || (a = vmaspace(p, addr, len)) == 0){
+    release(&mm.lock);
+    return -1;
+  }
+  v->start = a;
+  v->end = a + len;
+  v->prot = prot;
+  v->flags = flags;
+  v->ip = (flags & MAP_ANONYMOUS) ? 0 : idup(f->ip);
+  v->off = (flags & MAP_ANONYMOUS) ? 0 : off;
+  v->fend = v->end;
+  release(&mm.lock);
+  return a;
+}
+
+// Give p the n regions of a freshly exec'd program.  p has no
+// regions left (see vmafree); the regions' inode references
+// carry over.
+void
+vmaexec(struct proc *p, struct vma *seg, int n)
+{
+  int i;
+
+  acquire(&mm.lock);
+  for(i = 0; i < n; i++)
+    p->vma[i] = seg[i];
+  release(&mm.lock);
+}
+
+// Is a in one of p's stacks?  They are STACKLIMIT apart from
+// KERNBASE-PGSIZE down to p->baseofstack (see growstack), and
+// the lowest page of each is a guard page, never mapped.
+static int
+stackpage(struct proc *p, uint a)
+{
+  uint top = KERNBASE - PGSIZE;
+
+  return a >= p->baseofstack && a < top && (top - a) % STACKLIMIT != 0;
+}
+
+// Read the swapped-out page at a, whose PTE is pte, into mem and
+// map it.  Called and returns with mm.lock held.
+static void
+swapfault(uint a, pte_t *pte, char *mem)
+{
+  pte_t old;
+  uint slot;
+
+  old = *pte;
+  slot = PTE_ADDR(old) >> PTXSHIFT;
+  swapdup(slot);  // keep the slot while reading it
+  release(&mm.lock);
+  if(cpu->ncli > 0)
+    panic("pagefault: swapped page with lock held");
+  swapin(slot, mem);
+  acquire(&mm.lock);
+  // Another LWP may have read it in or unmapped it meanwhile.
+  pte = walkpgdir(proc->pgdir, (char*)a, 0);
+  if(pte && *pte == old){
+    *pte = V2P(mem) | (old & (PTE_W|PTE_U)) | PTE_P;
+    swapfree(slot);
+  } else
+    kfree(mem);
+  swapfree(slot);
+}
+
+// Handle a page fault at va in the current process by filling in
+// the page from its region or from swap, or by copying a
+// read-only page cache page on a write.  err is the fault's error
+// code.  Returns 0 if the access can be retried, -1 if it is a
+// real fault.
+int
+pagefault(uint va, uint err)
+{
+  struct proc *p;
+  struct vma *v, stack;
+  struct inode *ip;
+  pte_t *pte;
+  char *mem, *page;
+  uint a, off, n;
+  int perm, locked, cache;
+
+  if(proc == 0 || va >= KERNBASE)
+    return -1;
+  p = vmaproc();
+  a = PGROUNDDOWN(va);
+  if((mem = kallocswap()) == 0)
+    return -1;
+  memset(mem, 0, PGSIZE);
+  page = 0;
+
+  acquire(&mm.lock);
+  pte = walkpgdir(proc->pgdir, (char*)a, 0);
+  if(pte && (*pte & PTE_SWAP)){
+    swapfault(a, pte, mem);
+    release(&mm.lock);
+    return 0;
+  }
+  if(pte && (*pte & (PTE_P|PTE_U)) == (PTE_P|PTE_U) &&
+     (!(err & FEC_WR) || (*pte & PTE_W))){
+    // Another LWP faulted the page in first.
+    release(&mm.lock);
+    kfree(mem);
+    return 0;
+  }
+  if(pte && (*pte & (PTE_P|PTE_U|PTE_COW)) == (PTE_P|PTE_U|PTE_COW) &&
+     (err & FEC_WR)){
+    // A page handed to or from a pipe (see pagedonate).
+    page = P2V(PTE_ADDR(*pte));
+    if(krefcount(page) == 1){
+      *pte = (*pte & ~PTE_COW) | PTE_W;  // the last user
+      release(&mm.lock);
+      kfree(mem);
+      return 0;
+    }
+    memmove(mem, page, PGSIZE);
+    *pte = V2P(mem) | (PTE_FLAGS(*pte) & ~PTE_COW) | PTE_W;
+    release(&mm.lock);
+    tlbshootdown(proc->pgdir);
+    kfree(page);
+    return 0;
+  }
+  if((v = findvma(p, a)) == 0){
+    if(!stackpage(p, a))
+      goto bad;
+    // The stack grows down into its reserved area.
+    memset(&stack, 0, sizeof(stack));
+    stack.start = a;
+    stack.end = a + PGSIZE;
+    stack.prot = PROT_READ | PROT_WRITE;
+    stack.flags = MAP_PRIVATE;
+    v = &stack;
+  }
+  if((err & FEC_WR) && !(v->prot & PROT_WRITE))
+    goto bad;
+
+  if(pte && (*pte & PTE_P)){
+    // A write to a page shared with the page cache: copy it.
+    page = P2V(PTE_ADDR(*pte));
+    memmove(mem, page, PGSIZE);
+    *pte = V2P(mem) | PTE_FLAGS(*pte) | PTE_W;
+    release(&mm.lock);
+    tlbshootdown(proc->pgdir);
+    kfree(page);
+    return 0;
+  }
+
+  if(v->ip){
+    // Read the page from the file without mm.lock, since readi()
+    // sleeps.  The kernel can't do that with a spinlock held.
+    ip = v->ip;
+    off = v->off + (a - v->start);
+    n = a < v->fend ? v->fend - a : 0;
+    if(n > PGSIZE)
+      n = PGSIZE;
+    // Whole private pages come from the page cache.  A write
+    // fault would copy the cached page at once, so don't bother.
+    cache = !(v->flags & MAP_SHARED) && n == PGSIZE && !(err & FEC_WR);
+    mm.busy++;
+    release(&mm.lock);
+    if(cpu->ncli > 0)
+      panic("pagefault: file page with lock held");
+    if(cache)
+      page = pcachelookup(ip, off);
+    if(page == 0 && n > 0){
+      // sys_read and sys_write fault their buffers in before
+      // they lock the inode, but don't take the lock twice if a
+      // caller into this file's pages holds it already.
+      locked = !holdingsleepself(&ip->lock);
+      if(locked)
+        ilock(ip);
+      readi(ip, mem, off, n);  // zeroes past the end of file
+      if(locked)
+        iunlock(ip);
+      if(cache){
+        page = pcacheinsert(ip, off, mem);
+        mem = 0;
+      }
+    }
+    acquire(&mm.lock);
+    if(--mm.busy == 0)
+      wakeup(&mm.busy);
+    // The region may have been unmapped while we slept.
+    if((v = findvma(p, a)) == 0 || v->ip != ip)
+      goto bad;
+  }
+
+  if((pte = walkpgdir(proc->pgdir, (char*)a, 1)) == 0)
+    goto bad;
+  if(*pte & PTE_P){
+    // Another LWP faulted the page in first.
+    release(&mm.lock);
+    if(mem)
+      kfree(mem);
+    if(page)
+      kfree(page);
+    return 0;
+  }
+  if(page){
+    *pte = V2P(page) | PTE_U | PTE_P;  // read-only, see above
+  } else {
+    perm = PTE_U;
+    if(v->prot & PROT_WRITE)
+      perm |= PTE_W;
+    if(v->flags & MAP_SHARED)
+      perm |= PTE_SHARED;  // swapping would lose the mapping
+    *pte = V2P(mem) | perm | PTE_P;
+    mem = 0;
+  }
+  release(&mm.lock);
+  if(mem)
+    kfree(mem);
+  return 0;
+
+bad:
+  release(&mm.lock);
+  if(mem)
+    kfree(mem);
+  if(page)
+    kfree(page);
+  return -1;
+}
+
+// Can the page the current process maps with pte be given to or
+// taken from a pipe?  Private user pages only; no 4MB pages.
+static int
+pipepage(pte_t *pte)
+{
+  if(pte == 0 || (*pte & (PTE_P|PTE_U)) != (PTE_P|PTE_U))
+    return 0;
+  return (*pte & (PTE_W|PTE_COW)) && !(*pte & PTE_SHARED);
+}
+
+// Hand the n pages at va, which must be page aligned, to a pipe
+// without copying them: they become copy-on-write for the current
+// process and pages[] gets a reference to each.  Stops at the
+// first page that can't be handed over.  Returns the number of
+// pages in pages[].  Caller must not hold a spinlock.
+int
+pagedonate(uint va, int n, char **pages)
+{
+  pte_t *pte;
+  int i, flush;
+
+  flush = 0;
+  acquire(&mm.lock);
+  for(i = 0; i < n; i++, va += PGSIZE){
+    if((proc->pgdir[PDX(va)] & PTE_PS) || va >= KERNBASE)
+      break;
+    pte = walkpgdir(proc->pgdir, (char*)va, 0);
+    if(!pipepage(pte))
+      break;
+    if(*pte & PTE_W){
+      *pte = (*pte & ~PTE_W) | PTE_COW;
+      flush = 1;
+    }
+    pages[i] = P2V(PTE_ADDR(*pte));
+    kref(pages[i]);
+  }
+  release(&mm.lock);
+  // No more writes may reach the pages through the TLB.
+  if(flush)
+    tlbshootdown(proc->pgdir);
+  return i;
+}
+
+// Map the n pages in pages[], whole pages of data read from a
+// pipe, at page-aligned va in place of the current process's
+// pages there, copy-on-write.  Takes over the references to the
+// pages it maps.  Stops at the first page it can't replace.
+// Returns the number of pages mapped.  Caller must not hold a
+// spinlock.
+int
+pageaccept(uint va, char **pages, int n)
+{
+  pte_t *pte;
+  char *old[NPIPEBUF];
+  int i;
+
+  if(n > NPIPEBUF)
+    n = NPIPEBUF;
+  acquire(&mm.lock);
+  for(i = 0; i < n; i++, va += PGSIZE){
+    if((proc->pgdir[PDX(va)] & PTE_PS) || va >= KERNBASE)
+      break;
+    pte = walkpgdir(proc->pgdir, (char*)va, 0);
+    if(!pipepage(pte))
+      break;
+    old[i] = P2V(PTE_ADDR(*pte));
+    *pte = V2P(pages[i]) | (PTE_FLAGS(*pte) & ~(PTE_W|PTE_A|PTE_D)) | PTE_COW;
+  }
+  release(&mm.lock);
+  if(i > 0)
+    tlbshootdown(proc->pgdir);
+  n = i;
+  for(i = 0; i < n; i++)
+    kfree(old[i]);
+  return n;
+}
+
+// Make sure the user pages of [va, va+n) are present, and
+// writable if write is set, before the kernel touches them with a
+// spinlock held (pipes, console), when pagefault() could not read
+// a file page or swap.  The caller pins them with pinuvm().
+// Returns -1 if some page cannot be had, since a fault with the
+// spinlock held could not be survived.
+int
+prefault(uint va, uint n, int write)
+{
+  pte_t *pte;
+  uint a;
+
+  if(va >= KERNBASE || n > KERNBASE - va)
+    return -1;
+  for(a = PGROUNDDOWN(va); a < va + n; a += PGSIZE){
+    if(proc->pgdir[PDX(a)] & PTE_PS)
+      continue;
+    pte = walkpgdir(proc->pgdir, (char*)a, 0);
+    if(pte == 0 || !(*pte & PTE_P)){
+      if(pagefault(a, write ? FEC_WR : 0) < 0)
+        return -1;
+    } else if(write && !(*pte & PTE_W)){
+      if(pagefault(a, FEC_PR|FEC_WR) < 0)
+        return -1;
+    }
+  }
+  return 0;
+}
+
+// Write the dirty pages of shared file region v in [start, end)
+// back to its file.  Clears their dirty bits, so that the next
+// msync() only writes what changed since.  Never grows the file.
+static void
+writeback(pde_t *pgdir, struct vma *v, uint start, uint end)
+{
+  // a few blocks per transaction, as in filewrite().
+  int max = ((LOGSIZE-1-1-2) / 2) * BSIZE;
+  pte_t *pte;
+  uint a, off, i, n;
+  char *mem;
+
+  for(a = start; a < end; a += PGSIZE){
+    pte = walkpgdir(pgdir, (char*)a, 0);
+    if(pte == 0 || (*pte & (PTE_P|PTE_D)) != (PTE_P|PTE_D))
+      continue;
+    *pte &= ~PTE_D;
+    tlbshootdown(pgdir);  // so that later writes set PTE_D again
+    mem = P2V(PTE_ADDR(*pte));
+    off = v->off + (a - v->start);
+    for(i = 0; i < PGSIZE; i += n){
+      n = PGSIZE - i;
+      if(n > max)
+        n = max;
+      begin_op();
+      ilock(v->ip);
+      if(off + i >= v->ip->size)
+        n = 0;
+      else if(off + i + n > v->ip->size)
+        n = v->ip->size - (off + i);
+      if(n > 0)
+        writei(v->ip, mem + i, off + i, n);
+      iunlock(v->ip);
+      end_op();
+      if(n == 0)
+        break;
+    }
+  }
+}
+
+// Drop the file of a region that has been taken out of vma[].
+static void
+vmaput(struct vma *v)
+{
+  if(v->ip == 0)
+    return;
+  acquire(&mm.lock);
+  while(mm.busy > 0)  // a pagefault() may still be reading it
+    sleep(&mm.busy, &mm.lock);
+  release(&mm.lock);
+  begin_op();
+  iput(v->ip);
+  end_op();
+}
+
+// Tear down region v, already taken out of vma[]: write back its
+// dirty shared pages, unmap it from pgdir and drop the file.
+static void
+vmaclose(pde_t *pgdir, struct vma *v)
+{
+  if(v->ip && (v->flags & MAP_SHARED))
+    writeback(pgdir, v, v->start, v->end);
+  deallocuvm(pgdir, v->end, v->start);
+  vmaput(v);
+}
+
+// Unmap [addr, addr+len) from the current process.  Regions only
+// partly inside are trimmed, or split in two.
+int
+munmap(uint addr, uint len)
+{
+  struct proc *p;
+  struct vma *v, *nv, gone[NVMA];
+  uint end, s, e;
+  int i, n;
+
+  if(addr % PGSIZE != 0 || len == 0)
+    return -1;
+  end = addr + PGROUNDUP(len);
+  if(end < addr || end > KERNBASE)
+    return -1;
+
+  p = vmaproc();
+  acquire(&mm.lock);
+  // Splitting a region needs a free slot for the upper part.
+  nv = 0;
+  for(v = p->vma; v < &p->vma[NVMA]; v++)
+    if(v->end == 0)
+      nv = v;
+  for(v = p->vma; v < &p->vma[NVMA]; v++){
+    if(v->end != 0 && v->start < addr && end < v->end && nv == 0){
+      release(&mm.lock);
+      return -1;
+    }
+  }
+
+  n = 0;
+  for(v = p->vma; v < &p->vma[NVMA]; v++){
+    if(v->end == 0 || v == nv || v->end <= addr || end <= v->start)
+      continue;
+    s = v->start > addr ? v->start : addr;
+    e = v->end < end ? v->end : end;
+    gone[n] = *v;
+    gone[n].start = s;
+    gone[n].end = e;
+    gone[n].off = v->off + (s - v->start);
+    n++;
+    if(s == v->start && e == v->end){
+      v->end = 0;  // gone[] takes over the file reference
+      continue;
+    }
+    if(v->ip)
+      idup(v->ip);
+    if(s == v->start){
+      v->off += e - v->start;
+      v->start = e;
+    } else if(e == v->end){
+      v->end = s;
+    } else {
+      *nv = *v;
+      nv->off = v->off + (e - v->start);
+      nv->start = e;
+      v->end = s;
+      if(v->ip)
+        idup(v->ip);
+      nv = 0;
+    }
+  }
+  release(&mm.lock);
+
+  for(i = 0; i < n; i++)
+    vmaclose(proc->pgdir, &gone[i]);
+  return 0;
+}
+
+// Write the dirty pages of shared file regions in [addr, addr+len)
+// back to their files.
+int
+msync(uint addr, uint len)
+{
+  struct proc *p;
+  struct vma *v, sync[NVMA];
+  uint end;
+  int i, n;
+
+  if(addr % PGSIZE != 0)
+    return -1;
+  end = addr + PGROUNDUP(len);
+  if(end < addr || end > KERNBASE)
+    return -1;
+
+  p = vmaproc();
+  n = 0;
+  acquire(&mm.lock);
+  for(v = p->vma; v < &p->vma[NVMA]; v++){
+    if(v->end == 0 || v->end <= addr || end <= v->start)
+      continue;
+    if(v->ip == 0 || !(v->flags & MAP_SHARED))
+      continue;
+    sync[n] = *v;
+    idup(v->ip);
+    n++;
+  }
+  release(&mm.lock);
+
+  for(i = 0; i < n; i++){
+    v = &sync[i];
+    writeback(proc->pgdir, v, v->start > addr ? v->start : addr,
+              v->end < end ? v->end : end);
+    begin_op();
+    iput(v->ip);
+    end_op();
+  }
+  return 0;
+}
+
+// Give the child np of fork() the regions of the current process.
+// Shared pages are mapped into both, private ones copied.
+int
+vmacopy(struct proc *np)
+{
+  struct proc *p;
+  struct vma *v;
+  int i;
+
+  p = vmaproc();
+  acquire(&mm.lock);
+  for(i = 0; i < NVMA; i++){
+    np->vma[i] = p->vma[i];
+    if(np->vma[i].end != 0 && np->vma[i].ip)
+      idup(np->vma[i].ip);
+  }
+  release(&mm.lock);
+
+  // Program segments below the heap were copied by copyuvm().
+  for(v = np->vma; v < &np->vma[NVMA]; v++){
+    if(v->end == 0 || v->start < MMAPBASE)
+      continue;
+    if(copyuvmrange(proc->pgdir, np->pgdir, v->start, v->end,
+                    v->flags & MAP_SHARED) < 0)
+      return -1;
+  }
+  return 0;
+}
+
+// Remove all regions of p, whose address space is pgdir, at
+// exit() and exec() or when fork() fails.
+void
+vmafree(struct proc *p, pde_t *pgdir)
+{
+  struct vma *v, gone[NVMA];
+  int i, n;
+
+  n = 0;
+  acquire(&mm.lock);
+  for(v = p->vma; v < &p->vma[NVMA]; v++){
+    if(v->end == 0)
+      continue;
+    gone[n++] = *v;
+    v->end = 0;
+  }
+  release(&mm.lock);
+
+  for(i = 0; i < n; i++)
+    vmaclose(pgdir, &gone[i]);
+}
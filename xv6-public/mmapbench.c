@@ -0,0 +1,166 @@
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "fcntl.h"
+#include "mman.h"
+
+#define FILESIZE (1024*512)   // same size as hugefiletest's file
+#define NPASS    5
+
+char buf[512];
+
+// wc's inner loop over n bytes of p.
+void
+count(char *p, int n, int *l, int *w, int *c, int *inword)
+{
+  int i;
+
+  for(i = 0; i < n; i++){
+    (*c)++;
+    if(p[i] == '\n')
+      (*l)++;
+    if(strchr(" \r\t\n\v", p[i]))
+      *inword = 0;
+    else if(!*inword){
+      (*w)++;
+      *inword = 1;
+    }
+  }
+}
+
+// grep's inner loop: occurrences of pat in n bytes of p.
+int
+match(char *p, int n, char *pat)
+{
+  int i, j, k, m;
+
+  m = 0;
+  k = strlen(pat);
+  for(i = 0; i + k <= n; i++){
+    for(j = 0; j < k && p[i+j] == pat[j]; j++)
+      ;
+    if(j == k)
+      m++;
+  }
+  return m;
+}
+
+void
+mkfile(char *path)
+{
+  int fd, i, j;
+
+  fd = open(path, O_CREATE | O_RDWR);
+  if(fd < 0){
+    printf(1, "mmapbench: cannot create %s\n", path);
+    exit();
+  }
+  for(i = 0; i < FILESIZE / sizeof(buf); i++){
+    for(j = 0; j < sizeof(buf); j++)
+      buf[j] = (j % 64 == 63) ? '\n' : (j % 8 == 7) ? ' ' : 'a' + (i + j) % 26;
+    if(write(fd, buf, sizeof(buf)) != sizeof(buf)){
+      printf(1, "mmapbench: write failed\n");
+      exit();
+    }
+  }
+  close(fd);
+}
+
+// wc and grep through read() in 512-byte pieces, as wc and grep do.
+void
+readbench(char *path)
+{
+  int fd, n, i, l, w, c, inword, m, start;
+
+  start = uptime();
+  for(i = 0; i < NPASS; i++){
+    if((fd = open(path, O_RDONLY)) < 0)
+      exit();
+    l = w = c = inword = m = 0;
+    while((n = read(fd, buf, sizeof(buf))) > 0){
+      count(buf, n, &l, &w, &c, &inword);
+      m += match(buf, n, "abc");
+    }
+    close(fd);
+  }
+  printf(1, "read: %d %d %d, %d matches; %d passes in %d ticks\n",
+         l, w, c, m, NPASS, uptime() - start);
+}
+
+// the same over one mmap() of the whole file.
+void
+mmapbench(char *path)
+{
+  int fd, i, l, w, c, inword, m, start;
+  char *p;
+
+  start = uptime();
+  for(i = 0; i < NPASS; i++){
+    if((fd = open(path, O_RDONLY)) < 0)
+      exit();
+    p = mmap(0, FILESIZE, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(p == MAP_FAILED){
+      printf(1, "mmapbench: mmap failed\n");
+      exit();
+    }
+    l = w = c = inword = 0;
+    count(p, FILESIZE, &l, &w, &c, &inword);
+    m = match(p, FILESIZE, "abc");
+    munmap(p, FILESIZE);
+  }
+  printf(1, "mmap: %d %d %d, %d matches; %d passes in %d ticks\n",
+         l, w, c, m, NPASS, uptime() - start);
+}
+
+// a MAP_SHARED write reaches the file, and a child sees the
+// parent's pages.
+void
+sharedtest(char *path)
+{
+  int fd, pid;
+  char *p;
+
+  if((fd = open(path, O_RDWR)) < 0)
+    exit();
+  p = mmap(0, 4096, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+  if(p == MAP_FAILED){
+    printf(1, "mmapbench: shared mmap failed\n");
+    exit();
+  }
+  p[0] = 'X';
+  pid = fork();
+  if(pid == 0){
+    p[1] = 'Y';
+    exit();
+  }
+  wait();
+  if(p[1] != 'Y'){
+    printf(1, "mmapbench: child write not shared\n");
+    exit();
+  }
+  msync(p, 4096);
+  munmap(p, 4096);
+  read(fd, buf, 2);
+  close(fd);
+  if(buf[0] != 'X' || buf[1] != 'Y'){
+    printf(1, "mmapbench: msync did not write back\n");
+    exit();
+  }
+  printf(1, "shared mapping ok\n");
+}
+
+int
+main(int argc, char *argv[])
+{
+  char *path = (argc > 1) ? argv[1] : "mmapfile";
+
+  printf(1, "mmapbench starting\n");
+  mkfile(path);
+  readbench(path);
+  mmapbench(path);
+  sharedtest(path);
+  unlink(path);
+  printf(1, "mmapbench done\n");
+  exit();
+}
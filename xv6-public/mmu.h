@@ -38,6 +38,7 @@
 #define CR0_PG          0x80000000      // Paging
 
 #define CR4_PSE         0x00000010      // Page size extension
+#define CR4_PGE         0x00000080      // Page global enable
 
 // various segment selectors.
 #define SEG_KCODE 1  // kernel code
@@ -133,6 +134,15 @@ struct segdesc {
 #define PGROUNDUP(sz)  (((sz)+PGSIZE-1) & ~(PGSIZE-1))
 #define PGROUNDDOWN(a) (((a)) & ~(PGSIZE-1))
 
+#define SPGSIZE         (NPTENTRIES*PGSIZE)  // bytes mapped by a 4MB superpage (PTE_PS)
+#define SPGROUNDUP(sz)  (((sz)+SPGSIZE-1) & ~(SPGSIZE-1))
+#define SPGROUNDDOWN(a) (((a)) & ~(SPGSIZE-1))
+
+// Page fault error code bits (tf->err on T_PGFLT).
+#define FEC_PR          0x1     // Protection violation (page was present)
+#define FEC_WR          0x2     // Caused by a write
+#define FEC_U           0x4     // Fault happened in user mode
+
 // Page table/directory entry flags.
 #define PTE_P           0x001   // Present
 #define PTE_W           0x002   // Writeable
@@ -142,15 +152,17 @@ struct segdesc {
 #define PTE_A           0x020   // Accessed
 #define PTE_D           0x040   // Dirty
 #define PTE_PS          0x080   // Page Size
+#define PTE_G           0x100   // Global (kept across %cr3 loads)
 #define PTE_MBZ         0x180   // Bits must be zero
+#define PTE_SWAP        0x200   // Not present: in swap slot PTE_ADDR >> PTXSHIFT
+#define PTE_SHARED      0x400   // Page of a MAP_SHARED region, never swapped
+#define PTE_COW         0x800   // Read-only, copied on the first write
 
 // Address in page table or page directory entry
 #define PTE_ADDR(pte)   ((uint)(pte) & ~0xFFF)
 #define PTE_FLAGS(pte)  ((uint)(pte) &  0xFFF)
 
 #ifndef __ASSEMBLER__
-typedef uint pte_t;
-
 // Task state segment format
 struct taskstate {
   uint link;         // Old ts selector
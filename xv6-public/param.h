@@ -2,15 +2,20 @@
 #define KSTACKSIZE 4096  // size of per-process kernel stack
 #define NCPU          8  // maximum number of CPUs
 #define NOFILE       16  // open files per process
-#define NFILE       100  // open files per system
-#define NINODE       50  // maximum number of active i-nodes
 #define NDEV         10  // maximum major device number
 #define ROOTDEV       1  // device number of file system root disk
 #define MAXARG       32  // max exec arguments
 #define MAXOPBLOCKS  10  // max # of blocks any FS op writes
 #define LOGSIZE      (MAXOPBLOCKS*3)  // max data blocks in on-disk log
-#define NBUF         (MAXOPBLOCKS*3)  // size of disk block cache
+#define BCACHEMEM    16  // the block cache may use 1/BCACHEMEM of memory
+#define NIDLEINODE  256  // most unreferenced inodes the inode cache keeps
 #define FSSIZE       4000  // size of file system in blocks
+#define NSUPERPAGE      8  // 4MB pages set aside for large user heaps (0 = off)
+#define NVMA           16  // mmap() regions per process
+#define SWAPSIZE (8*1024*1024/BSIZE)  // blocks of swap space after the file system
+#define STACKLIMIT 0x100000 // bytes reserved for each user stack, guard page included
+#define MAXPATH      128  // maximum file path name
+#define NPIPEBUF       64  // most pages a pipe can hold (F_SETPIPE_SZ)
 
 #define ENTIRETICKETS 100           // entire tickets for stride scheduler
 #define ACCURATENUM   10            // use this number to make accurate stride
@@ -18,5 +23,6 @@
 #define MAXINT        2147483647    // max number of int
 
 #define LOG          0  // on-off LOG
+#define MEMTEST      0  // on-off boot-time check and timing of memmove() etc.
 #define TRUE         1
 #define FALSE        0
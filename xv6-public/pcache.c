@@ -0,0 +1,182 @@
+// Page cache for file pages mapped read-only into processes.
+//
+// Programs are mapped by exec() as private file regions (see
+// mmap.c).  Instead of every process reading its own copy of a
+// page of text, pagefault() looks the page up here by
+// (dev, inum, file offset) and maps the cached page read-only.
+// A write to such a page gets a private copy (copy on write).
+//
+// The cache holds one reference (kref) to each of its pages, and
+// every page table mapping one holds another, so the text of a
+// program stays resident after its last process exits.  A full
+// cache replaces the least recently used page that nobody maps.
+// exec() maps the cached pages of a program right away (see
+// pcachemap), so a hot binary takes no faults for them.  Writing
+// to or truncating the file drops its pages from the cache;
+// processes that map them keep the old contents.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "memlayout.h"
+#include "mmu.h"
+#include "proc.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "fs.h"
+#include "file.h"
+
+#define NPCACHE 256   // pages in the cache
+
+struct pcpage {
+  uint dev;
+  uint inum;
+  uint off;          // file offset of the page's first byte
+  char *page;        // 0 if the slot is free
+  uint used;         // pcache.clock at the last lookup
+};
+
+static struct {
+  struct spinlock lock;
+  struct pcpage page[NPCACHE];
+  uint clock;        // ticks once per lookup, for LRU
+} pcache;
+
+// Find the page of ip at off.  Caller must hold pcache.lock.
+static struct pcpage*
+pcachefind(struct inode *ip, uint off)
+{
+  struct pcpage *p;
+
+  for(p = pcache.page; p < &pcache.page[NPCACHE]; p++){
+    if(p->page && p->dev == ip->dev && p->inum == ip->inum && p->off == off){
+      p->used = ++pcache.clock;
+      return p;
+    }
+  }
+  return 0;
+}
+
+void
+pcacheinit(void)
+{
+  initlock(&pcache.lock, "pcache");
+}
+
+// Look up the page of ip at file offset off.  Returns the page
+// with a reference for the caller, or 0 if it is not cached.
+char*
+pcachelookup(struct inode *ip, uint off)
+{
+  struct pcpage *p;
+  char *page;
+
+  page = 0;
+  acquire(&pcache.lock);
+  if((p = pcachefind(ip, off)) != 0){
+    page = p->page;
+    kref(page);
+  }
+  release(&pcache.lock);
+  return page;
+}
+
+// Add page mem, holding the contents of ip at off, to the cache.
+// The caller's reference to mem carries over to the result, which
+// is the page to use: mem, or the copy another process cached
+// first (mem is then freed).  If no slot can be had mem is
+// returned uncached.
+char*
+pcacheinsert(struct inode *ip, uint off, char *mem)
+{
+  struct pcpage *p, *free;
+
+  acquire(&pcache.lock);
+  if((p = pcachefind(ip, off)) != 0){
+    kref(p->page);
+    release(&pcache.lock);
+    kfree(mem);
+    return p->page;
+  }
+  free = 0;
+  for(p = pcache.page; p < &pcache.page[NPCACHE]; p++){
+    if(p->page == 0){
+      free = p;
+      break;
+    }
+    // Else the least recently used page only the cache holds.
+    if(krefcount(p->page) == 1 && (free == 0 || p->used < free->used))
+      free = p;
+  }
+  if(free){
+    if(free->page)
+      kfree(free->page);
+    free->dev = ip->dev;
+    free->inum = ip->inum;
+    free->off = off;
+    free->page = mem;
+    free->used = ++pcache.clock;
+    kref(mem);
+  }
+  release(&pcache.lock);
+  return mem;
+}
+
+// Free the least recently used page that only the cache holds,
+// when memory runs out (see kallocswap).  Returns 0 if there is
+// none.
+int
+pcacheshrink(void)
+{
+  struct pcpage *p, *lru;
+
+  lru = 0;
+  acquire(&pcache.lock);
+  for(p = pcache.page; p < &pcache.page[NPCACHE]; p++)
+    if(p->page && krefcount(p->page) == 1 && (lru == 0 || p->used < lru->used))
+      lru = p;
+  if(lru){
+    kfree(lru->page);
+    lru->page = 0;
+  }
+  release(&pcache.lock);
+  return lru != 0;
+}
+
+// Drop the cached pages of ip, whose contents are changing.
+void
+pcacheinval(struct inode *ip)
+{
+  struct pcpage *p;
+
+  acquire(&pcache.lock);
+  for(p = pcache.page; p < &pcache.page[NPCACHE]; p++){
+    if(p->page && p->dev == ip->dev && p->inum == ip->inum){
+      kfree(p->page);
+      p->page = 0;
+    }
+  }
+  release(&pcache.lock);
+}
+
+// Map the cached pages of program segment v into pgdir, a new
+// address space exec() is building, read-only as pagefault()
+// would.  Pages that are not cached are left to pagefault().
+void
+pcachemap(pde_t *pgdir, struct vma *v)
+{
+  struct pcpage *p;
+  pte_t *pte;
+  uint a;
+
+  acquire(&pcache.lock);
+  for(a = v->start; a + PGSIZE <= v->fend; a += PGSIZE){
+    if((p = pcachefind(v->ip, v->off + (a - v->start))) == 0)
+      continue;
+    if((pte = walkpgdir(pgdir, (char*)a, 1)) == 0)
+      break;
+    kref(p->page);
+    *pte = V2P(p->page) | PTE_U | PTE_P;
+  }
+  release(&pcache.lock);
+}
@@ -0,0 +1,93 @@
+// PCI configuration space, through configuration mechanism #1
+// (ports 0xcf8 and 0xcfc).  Only bus 0 is scanned; that is where
+// QEMU's PC puts its devices.
+
+#include "types.h"
+#include "defs.h"
+#include "x86.h"
+#include "pci.h"
+
+#define PCI_ADDR      0xcf8
+#define PCI_DATA      0xcfc
+
+#define PCI_ID        0x00
+#define PCI_CMD       0x04
+#define PCI_CLASS     0x08
+#define PCI_HDR       0x0c
+#define PCI_BAR0      0x10
+#define PCI_INTR      0x3c
+
+#define PCI_CMD_IO    0x1
+#define PCI_CMD_MEM   0x2
+#define PCI_CMD_MASTER 0x4
+
+static uint
+pciaddr(struct pcidev *d, int reg)
+{
+  return 0x80000000 | (d->bus<<16) | (d->dev<<11) | (d->func<<8) | (reg&0xfc);
+}
+
+uint
+pciread(struct pcidev *d, int reg)
+{
+  outl(PCI_ADDR, pciaddr(d, reg));
+  return inl(PCI_DATA);
+}
+
+void
+pciwrite(struct pcidev *d, int reg, uint v)
+{
+  outl(PCI_ADDR, pciaddr(d, reg));
+  outl(PCI_DATA, v);
+}
+
+// Find the first function on bus 0 with the given vendor and
+// device ids, or class and subclass; PCI_ANY matches anything.
+// Fill in *d and return 0, or return -1.
+int
+pcifind(int vendor, int device, int class, int subclass, struct pcidev *d)
+{
+  uint id, cl, b;
+  int i, nfunc;
+
+  d->bus = 0;
+  for(d->dev = 0; d->dev < 32; d->dev++){
+    nfunc = 1;
+    for(d->func = 0; d->func < nfunc; d->func++){
+      if((id = pciread(d, PCI_ID)) == 0xffffffff)
+        continue;
+      if(d->func == 0 && (pciread(d, PCI_HDR) & 0x800000))
+        nfunc = 8;  // multi-function device
+      cl = pciread(d, PCI_CLASS);
+      d->vendor = id & 0xffff;
+      d->device = id >> 16;
+      d->class = cl >> 24;
+      d->subclass = (cl >> 16) & 0xff;
+      if((vendor != PCI_ANY && vendor != d->vendor) ||
+         (device != PCI_ANY && device != d->device) ||
+         (class != PCI_ANY && class != d->class) ||
+         (subclass != PCI_ANY && subclass != d->subclass))
+        continue;
+      d->bario = 0;
+      for(i = 0; i < 6; i++){
+        b = pciread(d, PCI_BAR0 + 4*i);
+        if(b & 1){
+          d->bar[i] = b & ~3;
+          d->bario |= 1<<i;
+        } else
+          d->bar[i] = b & ~0xf;
+      }
+      d->irq = pciread(d, PCI_INTR) & 0xff;
+      return 0;
+    }
+  }
+  return -1;
+}
+
+// Let d answer I/O and memory accesses and master the bus (DMA).
+void
+pcienable(struct pcidev *d)
+{
+  pciwrite(d, PCI_CMD, pciread(d, PCI_CMD) |
+           PCI_CMD_IO | PCI_CMD_MEM | PCI_CMD_MASTER);
+}
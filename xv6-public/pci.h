@@ -0,0 +1,15 @@
+// A PCI function, as found by pcifind().
+struct pcidev {
+  int bus;
+  int dev;
+  int func;
+  ushort vendor;
+  ushort device;
+  uchar class;
+  uchar subclass;
+  uchar irq;        // interrupt line the BIOS assigned
+  uint bar[6];      // base addresses, I/O or memory bit cleared
+  uint bario;       // bit i set if bar[i] is in I/O space
+};
+
+#define PCI_ANY       0xffff
@@ -8,17 +8,58 @@
 #include "sleeplock.h"
 #include "file.h"
 
-#define PIPESIZE 512
+#define PIPEPAGES 16  // pages a new pipe holds
+
+// A pipe is a ring of cap pages, PIPEPAGES unless changed with
+// fcntl(F_SETPIPE_SZ), at most NPIPEBUF.  Small writes are
+// copied into pages of the pipe's own, appending to the last one
+// while it has room.  A write of whole, page-aligned user pages
+// hands the pages themselves to the pipe (see pagedonate), and a
+// read of a whole page into a page-aligned buffer maps that page
+// into the reader (see pageaccept); both sides then share it
+// copy-on-write.  Other reads and writes copy with memmove().
+//
+// Readers and writers touch user memory with p->lock held; sys_read
+// and sys_write fault the pages in and pin them first.
+//
+// To save context switches, a writer only wakes a sleeping reader
+// when a page's worth of data is waiting, or when it is done writing
+// or must sleep itself, and a reader only wakes sleeping writers
+// once half of the ring is free.
+
+struct pipebuf {
+  char *page;
+  uint off;       // first unread byte
+  uint len;       // unread bytes
+};
 
 struct pipe {
   struct spinlock lock;
-  char data[PIPESIZE];
-  uint nread;     // number of bytes read
-  uint nwrite;    // number of bytes written
+  struct pipebuf buf[NPIPEBUF];
+  uint cap;       // pages in the ring
+  uint bytes;     // unread bytes
+  uint nread;     // number of pages fully read
+  uint nwrite;    // number of pages started by writers
+  int rwait;      // a reader sleeps on nread
+  int wwait;      // a writer sleeps on nwrite
   int readopen;   // read fd is still open
   int writeopen;  // write fd is still open
 };
 
+static struct kmem_cache *pipecache;
+
+static void
+pipector(void *v)
+{
+  initlock(&((struct pipe*)v)->lock, "pipe");
+}
+
+void
+pipeinit(void)
+{
+  pipecache = kmem_cache_create("pipe", sizeof(struct pipe), pipector);
+}
+
 int
 pipealloc(struct file **f0, struct file **f1)
 {
@@ -28,13 +69,16 @@ pipealloc(struct file **f0, struct file **f1)
   *f0 = *f1 = 0;
   if((*f0 = filealloc()) == 0 || (*f1 = filealloc()) == 0)
     goto bad;
-  if((p = (struct pipe*)kalloc()) == 0)
+  if((p = kmem_cache_alloc(pipecache)) == 0)
     goto bad;
   p->readopen = 1;
   p->writeopen = 1;
   p->nwrite = 0;
   p->nread = 0;
-  initlock(&p->lock, "pipe");
+  p->cap = PIPEPAGES;
+  p->bytes = 0;
+  p->rwait = 0;
+  p->wwait = 0;
   (*f0)->type = FD_PIPE;
   (*f0)->readable = 1;
   (*f0)->writable = 0;
@@ -48,7 +92,7 @@ pipealloc(struct file **f0, struct file **f1)
 //PAGEBREAK: 20
  bad:
   if(p)
-    kfree((char*)p);
+    kmem_cache_free(pipecache, p);
   if(*f0)
     fileclose(*f0);
   if(*f1)
@@ -68,39 +112,121 @@ pipeclose(struct pipe *p, int writable)
     wakeup(&p->nwrite);
   }
   if(p->readopen == 0 && p->writeopen == 0){
+    for(; p->nread != p->nwrite; p->nread++)
+      kfree(p->buf[p->nread % p->cap].page);
     release(&p->lock);
-    kfree((char*)p);
+    kmem_cache_free(pipecache, p);
   } else
     release(&p->lock);
 }
 
+// Wait until the ring has a free page, or the last one has room
+// to append to if append is set.  Returns -1 if the reader is gone.
+static int
+pipewait(struct pipe *p, int append)
+{
+  struct pipebuf *b;
+
+  for(;;){
+    if(p->readopen == 0 || proc->killed)
+      return -1;
+    if(p->nwrite != p->nread + p->cap)
+      return 0;
+    b = &p->buf[(p->nwrite - 1) % p->cap];
+    if(append && b->off + b->len < PGSIZE)
+      return 0;
+    p->rwait = 0;
+    wakeup(&p->nread);
+    p->wwait = 1;
+    sleep(&p->nwrite, &p->lock);  //DOC: pipewrite-sleep
+  }
+}
+
 //PAGEBREAK: 40
 int
 pipewrite(struct pipe *p, char *addr, int n)
 {
-  int i;
+  struct pipebuf *b;
+  char *pages[NPIPEBUF], *spare;
+  int i, j, k, m;
 
-  acquire(&p->lock);
-  for(i = 0; i < n; i++){
-    while(p->nwrite == p->nread + PIPESIZE){  //DOC: pipewrite-full
-      if(p->readopen == 0 || proc->killed){
-        release(&p->lock);
-        return -1;
+  spare = 0;
+  i = 0;
+  while(i < n){
+    k = 0;
+    if((uint)(addr + i) % PGSIZE == 0 && n - i >= PGSIZE){
+      // Whole pages: hand them over as many as there is room for.
+      acquire(&p->lock);
+      if(pipewait(p, 0) < 0)
+        goto bad;
+      k = p->cap - (p->nwrite - p->nread);
+      release(&p->lock);
+      if(k > (n - i) / PGSIZE)
+        k = (n - i) / PGSIZE;
+      k = pagedonate((uint)(addr + i), k, pages);
+    }
+    if(k > 0){
+      acquire(&p->lock);
+      for(j = 0; j < k; j++){
+        if(pipewait(p, 0) < 0){
+          for(; j < k; j++)
+            kfree(pages[j]);
+          goto bad;
+        }
+        b = &p->buf[p->nwrite++ % p->cap];
+        b->page = pages[j];
+        b->off = 0;
+        b->len = PGSIZE;
+        p->bytes += PGSIZE;
+        i += PGSIZE;
       }
-      wakeup(&p->nread);
-      sleep(&p->nwrite, &p->lock);  //DOC: pipewrite-sleep
+    } else {
+      // Copy: append to the last page, or start a new one.
+      if(spare == 0 && (spare = kalloc()) == 0)
+        return i > 0 ? i : -1;
+      acquire(&p->lock);
+      if(pipewait(p, 1) < 0)
+        goto bad;
+      b = &p->buf[(p->nwrite - 1) % p->cap];
+      if(p->nwrite == p->nread || b->off + b->len == PGSIZE){
+        b = &p->buf[p->nwrite++ % p->cap];
+        b->page = spare;
+        b->off = 0;
+        b->len = 0;
+        spare = 0;
+      }
+      m = PGSIZE - (b->off + b->len);
+      if(m > n - i)
+        m = n - i;
+      memmove(b->page + b->off + b->len, addr + i, m);
+      b->len += m;
+      p->bytes += m;
+      i += m;
+    }
+    // Wake the reader when a page's worth is waiting, or at the end.
+    if(p->rwait && (p->bytes >= PGSIZE || i == n)){
+      p->rwait = 0;
+      wakeup(&p->nread);  //DOC: pipewrite-wakeup1
     }
-    p->data[p->nwrite++ % PIPESIZE] = addr[i];
+    release(&p->lock);
   }
-  wakeup(&p->nread);  //DOC: pipewrite-wakeup1
+  if(spare)
+    kfree(spare);
+  return i;
+
+bad:
   release(&p->lock);
-  return n;
+  if(spare)
+    kfree(spare);
+  return -1;
 }
 
 int
 piperead(struct pipe *p, char *addr, int n)
 {
-  int i;
+  struct pipebuf *b;
+  char *pages[NPIPEBUF];
+  int i, j, k, m, moff;
 
   acquire(&p->lock);
   while(p->nread == p->nwrite && p->writeopen){  //DOC: pipe-empty
@@ -108,14 +234,86 @@ piperead(struct pipe *p, char *addr, int n)
       release(&p->lock);
       return -1;
     }
+    p->rwait = 1;
     sleep(&p->nread, &p->lock); //DOC: piperead-sleep
   }
-  for(i = 0; i < n; i++){  //DOC: piperead-copy
-    if(p->nread == p->nwrite)
-      break;
-    addr[i] = p->data[p->nread++ % PIPESIZE];
+  k = 0;
+  moff = 0;
+  for(i = 0; i < n && p->nread != p->nwrite; i += m){  //DOC: piperead-copy
+    b = &p->buf[p->nread % p->cap];
+    if(b->off == 0 && b->len == PGSIZE && k < NPIPEBUF &&
+       (uint)(addr + i) % PGSIZE == 0 && n - i >= PGSIZE &&
+       (k == 0 || moff + k*PGSIZE == i)){
+      // A whole page to a page-aligned buffer: map it below.
+      if(k == 0)
+        moff = i;
+      pages[k++] = b->page;
+      p->nread++;
+      p->bytes -= PGSIZE;
+      m = PGSIZE;
+      continue;
+    }
+    m = b->len;
+    if(m > n - i)
+      m = n - i;
+    memmove(addr + i, b->page + b->off, m);
+    b->off += m;
+    b->len -= m;
+    p->bytes -= m;
+    if(b->len == 0){
+      kfree(b->page);
+      p->nread++;
+    }
+  }
+  // Wake writers once half of the ring is free.
+  if(p->wwait && 2*(p->cap - (p->nwrite - p->nread)) >= p->cap){
+    p->wwait = 0;
+    wakeup(&p->nwrite);  //DOC: piperead-wakeup
   }
-  wakeup(&p->nwrite);  //DOC: piperead-wakeup
   release(&p->lock);
+
+  // Pages that can't be mapped are copied after all.
+  j = pageaccept((uint)(addr + moff), pages, k);
+  for(; j < k; j++){
+    memmove(addr + moff + j*PGSIZE, pages[j], PGSIZE);
+    kfree(pages[j]);
+  }
   return i;
 }
+
+// Capacity of the pipe in bytes.
+int
+pipesize(struct pipe *p)
+{
+  return p->cap * PGSIZE;
+}
+
+// Resize the ring to hold n bytes, rounded up to whole pages.
+// Fails if more pages than that are in use.
+int
+pipesetsize(struct pipe *p, int n)
+{
+  struct pipebuf buf[NPIPEBUF];
+  uint cap, i, used;
+
+  if(n <= 0 || n > NPIPEBUF * PGSIZE)
+    return -1;
+  cap = PGROUNDUP(n) / PGSIZE;
+  acquire(&p->lock);
+  used = p->nwrite - p->nread;
+  if(used > cap){
+    release(&p->lock);
+    return -1;
+  }
+  // Index the pages in use from 0 again, modulo the new size.
+  for(i = 0; i < used; i++)
+    buf[i] = p->buf[(p->nread + i) % p->cap];
+  for(i = 0; i < used; i++)
+    p->buf[i] = buf[i];
+  p->nread = 0;
+  p->nwrite = used;
+  p->cap = cap;
+  wakeup(&p->nwrite);
+  release(&p->lock);
+  return cap * PGSIZE;
+}
@@ -0,0 +1,139 @@
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "fcntl.h"
+
+#define FILESIZE (512*1024)
+#define NCAT     4
+#define CHUNK    (64*1024)
+#define TOTAL    (8*1024*1024)
+
+char buf[512];
+
+// print n bytes moved in t ticks (100 ticks a second) as MB/s.
+void
+rate(char *what, int n, int t)
+{
+  if(t == 0)
+    t = 1;
+  printf(1, "%s: %d KB in %d ticks, %d MB/s\n", what, n / 1024, t,
+         n / 1024 * 100 / 1024 / t);
+}
+
+void
+mkfile(char *path)
+{
+  int fd, i, j;
+
+  if((fd = open(path, O_CREATE | O_RDWR)) < 0){
+    printf(1, "pipebench: cannot create %s\n", path);
+    exit();
+  }
+  for(i = 0; i < FILESIZE / sizeof(buf); i++){
+    for(j = 0; j < sizeof(buf); j++)
+      buf[j] = (j % 64 == 63) ? '\n' : (j % 8 == 7) ? ' ' : 'a' + (i + j) % 26;
+    write(fd, buf, sizeof(buf));
+  }
+  close(fd);
+}
+
+// cat path | wc, NCAT times.
+void
+catwc(char *path)
+{
+  char *cat[] = { "cat", path, 0 };
+  char *wc[] = { "wc", 0 };
+  int fds[2], i, start;
+
+  start = uptime();
+  for(i = 0; i < NCAT; i++){
+    if(pipe(fds) < 0){
+      printf(1, "pipe failed\n");
+      exit();
+    }
+    if(fork() == 0){
+      close(1);
+      dup(fds[1]);
+      close(fds[0]);
+      close(fds[1]);
+      exec("cat", cat);
+      exit();
+    }
+    if(fork() == 0){
+      close(0);
+      dup(fds[0]);
+      close(fds[0]);
+      close(fds[1]);
+      exec("wc", wc);
+      exit();
+    }
+    close(fds[0]);
+    close(fds[1]);
+    wait();
+    wait();
+  }
+  rate("cat | wc", NCAT * FILESIZE, uptime() - start);
+}
+
+// a page-aligned buffer of n bytes.
+char*
+pagebuf(int n)
+{
+  char *p;
+
+  p = sbrk(n + 4096);
+  return (char*)(((uint)p + 4095) & ~4095);
+}
+
+// TOTAL bytes from a child to us in CHUNK writes from src and
+// reads into dst.  Page-aligned buffers move whole pages.
+void
+stream(char *what, char *src, char *dst)
+{
+  int fds[2], n, got, start;
+
+  if(pipe(fds) < 0){
+    printf(1, "pipe failed\n");
+    exit();
+  }
+  start = uptime();
+  if(fork() == 0){
+    close(fds[0]);
+    for(n = 0; n < TOTAL; n += CHUNK)
+      if(write(fds[1], src, CHUNK) != CHUNK)
+        break;
+    exit();
+  }
+  close(fds[1]);
+  got = 0;
+  while((n = read(fds[0], dst, CHUNK)) > 0)
+    got += n;
+  close(fds[0]);
+  wait();
+  if(got != TOTAL)
+    printf(1, "%s: got %d bytes, expected %d\n", what, got, TOTAL);
+  if(dst[0] != src[0] || dst[CHUNK-1] != src[CHUNK-1])
+    printf(1, "%s: data mismatch\n", what);
+  rate(what, got, uptime() - start);
+}
+
+int
+main(int argc, char *argv[])
+{
+  char *src, *dst;
+  int i;
+
+  printf(1, "pipebench starting\n");
+  mkfile("pipefile");
+  catwc("pipefile");
+  unlink("pipefile");
+
+  src = pagebuf(CHUNK + 1);
+  dst = pagebuf(CHUNK + 1);
+  for(i = 0; i < CHUNK + 1; i++)
+    src[i] = i % 251;
+  stream("page-aligned", src, dst);
+  stream("unaligned", src + 1, dst + 1);
+  printf(1, "pipebench done\n");
+  exit();
+}
@@ -0,0 +1,144 @@
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "fcntl.h"
+
+#define NROUND 20
+#define TOTAL  (1024*1024)
+#define CHUNK  512   // cat's and wc's buffer
+
+char buf[4096];
+
+// a pipe holding size bytes.
+void
+mkpipe(int fds[2], int size)
+{
+  if(pipe(fds) < 0){
+    printf(1, "pipe failed\n");
+    exit();
+  }
+  if(fcntl(fds[1], F_SETPIPE_SZ, size) != size){
+    printf(1, "pipesizebench: F_SETPIPE_SZ %d failed\n", size);
+    exit();
+  }
+}
+
+// run argv with fd in on stdin and fd out on stdout.
+void
+run(char **argv, int in, int out, int *fds1, int *fds2)
+{
+  if(fork() == 0){
+    if(in >= 0){
+      close(0);
+      dup(in);
+    }
+    if(out >= 0){
+      close(1);
+      dup(out);
+    }
+    close(fds1[0]);
+    close(fds1[1]);
+    close(fds2[0]);
+    close(fds2[1]);
+    exec(argv[0], argv);
+    exit();
+  }
+}
+
+// cat README | grep the | wc, NROUND times, through pipes of
+// size bytes.
+void
+pipeline(int size)
+{
+  char *cat[] = { "cat", "README", 0 };
+  char *grep[] = { "grep", "the", 0 };
+  char *wc[] = { "wc", 0 };
+  int a[2], b[2], i, start, sw;
+
+  start = uptime();
+  sw = cswitches();
+  for(i = 0; i < NROUND; i++){
+    mkpipe(a, size);
+    mkpipe(b, size);
+    run(cat, -1, a[1], a, b);
+    run(grep, a[0], b[1], a, b);
+    run(wc, b[0], -1, a, b);
+    close(a[0]);
+    close(a[1]);
+    close(b[0]);
+    close(b[1]);
+    wait();
+    wait();
+    wait();
+  }
+  printf(1, "cat | grep | wc, %d KB pipes: %d rounds, %d switches, %d ticks\n",
+         size / 1024, NROUND, cswitches() - sw, uptime() - start);
+}
+
+// TOTAL bytes from a child to us in CHUNK writes and reads,
+// as cat and wc do, through a pipe of size bytes.
+void
+stream(int size)
+{
+  int fds[2], n, got, start, sw;
+
+  mkpipe(fds, size);
+  start = uptime();
+  sw = cswitches();
+  if(fork() == 0){
+    close(fds[0]);
+    for(n = 0; n < TOTAL; n += CHUNK)
+      if(write(fds[1], buf, CHUNK) != CHUNK)
+        break;
+    exit();
+  }
+  close(fds[1]);
+  got = 0;
+  while((n = read(fds[0], buf, CHUNK)) > 0)
+    got += n;
+  close(fds[0]);
+  wait();
+  if(got != TOTAL)
+    printf(1, "stream: got %d bytes, expected %d\n", got, TOTAL);
+  printf(1, "512-byte stream, %d KB pipe: %d KB, %d switches, %d ticks\n",
+         size / 1024, got / 1024, cswitches() - sw, uptime() - start);
+}
+
+// F_GETPIPE_SZ and F_SETPIPE_SZ limits.
+void
+sizetest(void)
+{
+  int fds[2];
+
+  if(pipe(fds) < 0)
+    exit();
+  printf(1, "default pipe size %d\n", fcntl(fds[0], F_GETPIPE_SZ, 0));
+  if(fcntl(fds[0], F_SETPIPE_SZ, 100) != 4096)
+    printf(1, "pipesizebench: size not rounded to a page\n");
+  if(fcntl(fds[0], F_SETPIPE_SZ, 1024*1024*1024) != -1)
+    printf(1, "pipesizebench: huge size accepted\n");
+  fcntl(fds[0], F_SETPIPE_SZ, 8192);
+  write(fds[1], buf, 4096);
+  write(fds[1], buf, 1);
+  if(fcntl(fds[0], F_SETPIPE_SZ, 4096) != -1)
+    printf(1, "pipesizebench: shrank below contents\n");
+  if(fcntl(fds[0], F_SETPIPE_SZ, 16384) != 16384 ||
+     read(fds[0], buf, 100) != 100)
+    printf(1, "pipesizebench: resize lost data\n");
+  close(fds[0]);
+  close(fds[1]);
+}
+
+int
+main(int argc, char *argv[])
+{
+  printf(1, "pipesizebench starting\n");
+  sizetest();
+  pipeline(4096);
+  pipeline(64*1024);
+  stream(4096);
+  stream(64*1024);
+  stream(256*1024);
+  printf(1, "pipesizebench done\n");
+  exit();
+}
@@ -1,5 +1,6 @@
 #include "types.h"
 #include "defs.h"
+#include "param.h"
 
 // Simple system call
 int
@@ -14,9 +15,9 @@ my_syscall(char *str)
 int
 sys_my_syscall(void)
 {
-    char *str;
+    char str[MAXPATH];
     // Decode argument using argstr
-    if (argstr(0, &str) < 0)
+    if (argstr(0, str, sizeof(str)) < 0)
         return -1;
     return my_syscall(str);
 }
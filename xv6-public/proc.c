@@ -14,6 +14,7 @@ const int quantum[NUMLEVEL] = {5, 10, 20};
 struct {
   struct spinlock lock;
   struct proc proc[NPROC];
+  uint nswitch;   // calls to sched(), for cswitches()
 } ptable;
 
 // 1.4 Process pointer table for MLFQ
@@ -119,6 +120,7 @@ found:
   // init proc properties for MLFQ
   p->level = 0;
   p->usedticks = 0;
+  p->vmpin = 0;
 
   p->state = EMBRYO;
   p->pid = nextpid++;
@@ -190,6 +192,83 @@ userinit(void)
   release(&ptable.lock);
 }
 
+// Clock hand for swapvictim(): a process and an address in it.
+static struct {
+  int i;
+  uint va;
+} hand;
+
+// Can swapvictim() take pages from process p's address space?
+// Not while it or one of its LWPs runs on another CPU, or has
+// pinned it (see pinuvm).  Caller must hold ptable.lock, which
+// keeps them from starting to run.
+static int
+swappable(struct proc *p)
+{
+  struct proc *q;
+
+  if(p->threadof != 0 || p->pgdir == 0)
+    return 0;
+  if(p->state != RUNNABLE && p->state != SLEEPING && p->state != RUNNING)
+    return 0;
+  for(q = ptable.proc; q < &ptable.proc[NPROC]; q++){
+    if(q != p && q->threadof != p)
+      continue;
+    if(q->state == UNUSED || q->state == EMBRYO || q->state == ZOMBIE)
+      continue;
+    if(q->vmpin > 0 || (q->state == RUNNING && q != proc))
+      return 0;
+  }
+  return 1;
+}
+
+// Pick a user page to swap out with the clock algorithm: a
+// private writable page that no one else maps and that has not
+// been accessed since the hand last went by.  Points its PTE at
+// swap slot slot, and returns the page, now owned by the caller,
+// and its pgdir in *pgdirp.  Returns 0 if there is none.
+char*
+swapvictim(int slot, pde_t **pgdirp)
+{
+  struct proc *p;
+  pde_t *pde;
+  pte_t *pte;
+  char *page;
+  int n;
+
+  acquire(&ptable.lock);
+  // Twice around: the first pass may only clear PTE_A bits.
+  for(n = 0; n <= 2*NPROC; n++, hand.i = (hand.i + 1) % NPROC, hand.va = 0){
+    p = &ptable.proc[hand.i];
+    if(!swappable(p))
+      continue;
+    for(; hand.va < KERNBASE; hand.va += PGSIZE){
+      pde = &p->pgdir[PDX(hand.va)];
+      if((*pde & PTE_P) == 0 || (*pde & PTE_PS)){
+        hand.va = PGADDR(PDX(hand.va) + 1, 0, 0) - PGSIZE;
+        continue;
+      }
+      pte = walkpgdir(p->pgdir, (char*)hand.va, 0);
+      if((*pte & (PTE_P|PTE_W|PTE_U|PTE_SHARED)) != (PTE_P|PTE_W|PTE_U))
+        continue;
+      if(*pte & PTE_A){
+        *pte &= ~PTE_A;
+        continue;
+      }
+      page = P2V(PTE_ADDR(*pte));
+      if(krefcount(page) != 1)
+        continue;
+      *pte = (slot << PTXSHIFT) | PTE_SWAP | (*pte & (PTE_W|PTE_U));
+      *pgdirp = p->pgdir;
+      hand.va += PGSIZE;
+      release(&ptable.lock);
+      return page;
+    }
+  }
+  release(&ptable.lock);
+  return 0;
+}
+
 // Grow current process's memory by n bytes.
 // Return 0 on success, -1 on failure.
 // LWP2 - 1.4.1.2 growproc
@@ -205,6 +284,8 @@ growproc(int n)
   }
 
   if(n > 0){
+    if(sz + n > MMAPBASE)  // mmap() regions live above
+      return -1;
     if((sz = allocuvm(proc->pgdir, sz, sz + n)) == 0)
       return -1;
   } else if(n < 0){
@@ -240,19 +321,16 @@ growstack(int isgrow)
   }
 
   if(isgrow){
-    if(baseofstack - 2*PGSIZE < topofheap){
+    if(baseofstack - STACKLIMIT < topofheap || baseofstack - STACKLIMIT < MMAPTOP){
       cprintf("LOG: growstack - stack can't be allocate more\n");
       return -1;
     }
 
-    new_baseofstack = baseofstack - 2*PGSIZE;
-
-    if((allocuvm(proc->pgdir, baseofstack - 2*PGSIZE, baseofstack)) == 0)
-      return -1;
-
-    clearpteu(proc->pgdir, (char*)new_baseofstack);
+    // Only reserve it: pagefault() maps pages as they are
+    // touched, except the guard page at the bottom.
+    new_baseofstack = baseofstack - STACKLIMIT;
   }else{
-    new_baseofstack = baseofstack + 2*PGSIZE;
+    new_baseofstack = baseofstack + STACKLIMIT;
     if((deallocuvm(proc->pgdir, new_baseofstack, baseofstack)) == 0)
       return -1;
   }
@@ -284,12 +362,26 @@ fork(void)
 
   // Copy address space
   // LWP2 - 1.2.1.1 copy two distinguished area.
+  pinuvm();
   if((np->pgdir = copyuvm(proc->pgdir, proc->topofheap, proc->baseofstack)) == 0){
+    unpinuvm();
     kfree(np->kstack);
     np->kstack = 0;
     np->state = UNUSED;
     return -1;
   }
+  // mmap() regions: shared pages stay shared, private ones are copied.
+  if(vmacopy(np) < 0){
+    unpinuvm();
+    vmafree(np, np->pgdir);
+    freevm(np->pgdir);
+    np->pgdir = 0;
+    kfree(np->kstack);
+    np->kstack = 0;
+    np->state = UNUSED;
+    return -1;
+  }
+  unpinuvm();
   np->sz = proc->sz;
   // LWP2 - 1.2.1.2 copy new properties for new address space design.
   np->topofheap = proc->topofheap;
@@ -327,6 +419,9 @@ exit(void)
   if(proc == initproc)
     panic("init exiting");
 
+  // write back and drop mmap() regions while we can still sleep.
+  vmafree(proc->threadof ? proc->threadof : proc, proc->pgdir);
+
   // LWP2 - 1.1.1 work flow except entering scheduler.
   cleanup_all(proc->pgdir);
 
@@ -589,7 +684,7 @@ found:
   switchuvm(p);
   p->state = RUNNING;
   swtch(&cpu->scheduler, p->context);
-  switchkvm();
+  // keep p's pgdir loaded: the next proc may be an LWP sharing it.
   proc = 0;
 }
 
@@ -644,11 +739,24 @@ sched(void)
     current->usedticks = 0;
   }
 
+  ptable.nswitch++;
   intena = cpu->intena;
   swtch(&proc->context, cpu->scheduler);
   cpu->intena = intena;
 }
 
+// Context switches so far.
+int
+cswitches(void)
+{
+  int n;
+
+  acquire(&ptable.lock);
+  n = ptable.nswitch;
+  release(&ptable.lock);
+  return n;
+}
+
 // Give up the CPU for one scheduling round.
 void
 yield(void)
@@ -745,6 +853,8 @@ forkret(void)
     first = 0;
     iinit(ROOTDEV);
     initlog(ROOTDEV);
+    bsuminit(ROOTDEV);
+    swapinit(ROOTDEV);
   }
 
   // Return to "caller", actually trapret (see allocproc).
@@ -908,7 +1018,12 @@ thread_create(thread_t *thread, void *(*start_routine)(void*), void *arg)
   }
 
   // LWP 1.4.2 return thread's pid
-  *thread = np->pid;
+  if(copyout(proc->pgdir, (uint)thread, &np->pid, sizeof(np->pid)) < 0){
+    kfree(np->kstack);
+    np->kstack = 0;
+    np->state = UNUSED;
+    return -1;
+  }
 
   // LWP 1.4.3
   // thread's PCB will remember it's main process
@@ -1027,6 +1142,7 @@ int
 thread_join(thread_t thread, void **retval)
 {
   struct proc *p;
+  uint ret;
 
   acquire(&ptable.lock);
 
@@ -1036,13 +1152,15 @@ thread_join(thread_t thread, void **retval)
     found:
       // LWP 3.2.2 check ZOMBIE
       if(p->state == ZOMBIE){
-        // LWP 3.2.5 return value
-        if(retval != 0)
-          *retval = (void*)p->threadret;
+        // LWP 3.2.5 return value.  Stored after release, since
+        // touching user memory may fault the page in (swap.c).
+        ret = p->threadret;
 
         freeThreadPCB(p);
 
         release(&ptable.lock);
+        if(retval != 0)
+          copyout(proc->pgdir, (uint)retval, &ret, sizeof(ret));
 
         removeProcPtr(p);
         // LWP 3.2.6 free user stack
@@ -1120,10 +1238,10 @@ cleanup_ustack()
       cprintf("LOG: Can't dealloc stack\n");
       return -1;
     }
-    baseofstack += 2*PGSIZE;
+    baseofstack += STACKLIMIT;
 
     // should not dealloc mainPCB's user stack
-    if(mainPCB->tf->esp < (baseofstack + 2*PGSIZE))
+    if(mainPCB->tf->esp < (baseofstack + STACKLIMIT))
       break;
   }
 
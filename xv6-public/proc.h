@@ -7,6 +7,9 @@ struct cpu {
   volatile uint started;       // Has the CPU started?
   int ncli;                    // Depth of pushcli nesting.
   int intena;                  // Were interrupts enabled before pushcli?
+  pde_t *pgdir;                // Page table loaded in %cr3
+  volatile uint tlbreq;        // TLB flushes other CPUs asked for
+  volatile uint tlbdone;       // TLB flushes done (see tlbintr)
 
   // Cpu-local storage variables; see below
   struct cpu *cpu;
@@ -52,6 +55,17 @@ enum procstate { UNUSED, EMBRYO, SLEEPING, RUNNABLE, RUNNING, ZOMBIE };
 const int quantum[3]; 
 
 // 1.1.5 Per-process state
+// A memory region made by mmap(), see mmap.c.
+struct vma {
+  uint start;                  // First address, page aligned
+  uint end;                    // One past the last address, page aligned (0 if unused)
+  int prot;                    // PROT_READ, PROT_WRITE
+  int flags;                   // MAP_SHARED or MAP_PRIVATE, MAP_ANONYMOUS
+  struct inode *ip;            // Backing file, 0 if anonymous
+  uint off;                    // File offset of start
+  uint fend;                   // File data stops here, zeroes above (bss)
+};
+
 struct proc {
   uint sz;                     // Size of process memory (bytes)
   uint topofheap;              // Top of heap area
@@ -77,6 +91,10 @@ struct proc {
   struct proc *threadof;       // LWP 1.3.1 If non-zero, it's process PCB
   struct proc *returnto;       // LWP 1.3.2 PCB which call join for this thread         
   uint threadret;              // LWP 1.3.3 save thread's retern value
+
+  /* Memory mappings, only the process PCB's are used (see vmaproc) */
+  struct vma vma[NVMA];
+  int vmpin;                   // If non-zero, don't swap out pages (see swap.c)
 };
 
 // Process memory is laid out contiguously, low addresses first:
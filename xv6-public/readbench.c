@@ -0,0 +1,55 @@
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "fcntl.h"
+#include "fs.h"
+
+char buf[512];
+
+// read path sequentially in 512-byte pieces, as cat does, and
+// print the rate.  The first run after boot reads from the disk;
+// later ones find the file in the buffer cache.
+void
+readfile(char *path)
+{
+  uint hit0, miss0, hit, miss, intr0, xfer0, cyc0, intr, xfer, cyc;
+  int fd, n, tot, t;
+
+  if((fd = open(path, O_RDONLY)) < 0){
+    printf(1, "readbench: cannot open %s\n", path);
+    return;
+  }
+  bstat(&hit0, &miss0);
+  idestat(&intr0, &xfer0, &cyc0);
+  t = uptime();
+  tot = 0;
+  while((n = read(fd, buf, sizeof(buf))) > 0)
+    tot += n;
+  t = uptime() - t;
+  bstat(&hit, &miss);
+  idestat(&intr, &xfer, &cyc);
+  close(fd);
+  if(t == 0)
+    t = 1;
+  xfer -= xfer0;
+  printf(1, "%s: %d KB in %d ticks, %d KB/s, %d hits, %d misses\n",
+         path, tot / 1024, t, tot / t * 100 / 1024, hit - hit0, miss - miss0);
+  printf(1, "  disk: %d interrupts for %d blocks, %d driver cycles/MB\n",
+         intr - intr0, xfer, xfer ? (cyc - cyc0) / xfer * (1024*1024/BSIZE) : 0);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int i;
+
+  printf(1, "readbench starting\n");
+  if(argc < 2){
+    readfile("bigbin");
+    readfile("bigbin");
+  }
+  for(i = 1; i < argc; i++)
+    readfile(argv[i]);
+  printf(1, "readbench done\n");
+  exit();
+}
@@ -0,0 +1,88 @@
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+
+#define NSHELL 20
+#define NEXEC  100
+
+// free pages used by NSHELL shells waiting at their prompt.  They
+// read commands from a pipe that stays empty, and print their
+// prompts into another that nobody reads.
+void
+shellsbench(void)
+{
+  char *argv[] = { "sh", 0 };
+  int in[2], out[2], i, pid, before, during;
+
+  if(pipe(in) < 0 || pipe(out) < 0){
+    printf(1, "pipe failed\n");
+    exit();
+  }
+  before = freemem();
+  for(i = 0; i < NSHELL; i++){
+    pid = fork();
+    if(pid < 0){
+      printf(1, "fork failed at %d\n", i);
+      exit();
+    }
+    if(pid == 0){
+      close(0);
+      dup(in[0]);
+      close(1);
+      dup(out[1]);
+      close(2);
+      dup(out[1]);
+      close(in[0]);
+      close(in[1]);
+      close(out[0]);
+      close(out[1]);
+      exec("sh", argv);
+      exit();
+    }
+  }
+  sleep(100);  // let every shell reach its prompt
+  during = freemem();
+  close(in[1]);  // end of input: the shells exit
+  for(i = 0; i < NSHELL; i++)
+    wait();
+  close(in[0]);
+  close(out[0]);
+  close(out[1]);
+  printf(1, "%d shells: %d pages, %d per shell\n",
+         NSHELL, before - during, (before - during) / NSHELL);
+}
+
+// time NEXEC fork()/exec()/exit()/wait() rounds of a binary that
+// is already in the page cache.
+void
+hotbench(void)
+{
+  char *argv[] = { "echo", "hot", 0 };
+  int i, pid, start;
+
+  start = uptime();
+  for(i = 0; i < NEXEC; i++){
+    pid = fork();
+    if(pid < 0){
+      printf(1, "fork failed at %d\n", i);
+      exit();
+    }
+    if(pid == 0){
+      close(1);
+      exec("echo", argv);
+      exit();
+    }
+    wait();
+  }
+  printf(1, "hot echo: %d execs in %d ticks\n", NEXEC, uptime() - start);
+}
+
+int
+main(int argc, char *argv[])
+{
+  printf(1, "shellbench starting\n");
+  shellsbench();
+  hotbench();
+  printf(1, "shellbench done\n");
+  exit();
+}
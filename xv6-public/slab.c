@@ -0,0 +1,217 @@
+// Slab allocator for small kernel objects.
+//
+// kalloc() only hands out whole 4096-byte pages, which wastes most
+// of a page on objects like struct pipe or struct file.  A kmem_cache
+// carves pages (slabs) into equal-sized objects:
+//
+//   [ struct slab | obj | obj | ... | obj ]
+//
+// Each slab keeps its own free list and the cache keeps a list of
+// slabs that still have free objects.  An object finds its slab by
+// rounding its address down to the page boundary.
+//
+// Objects are built by the cache's constructor once, when their slab
+// is created, and callers must hand them back to kmem_cache_free()
+// in that constructed state (e.g. with their sleeplock released).
+//
+// Each CPU also keeps a small stack of recently freed objects, so the
+// common alloc/free pair runs with interrupts off and without taking
+// the cache lock at all.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "memlayout.h"
+#include "mmu.h"
+#include "proc.h"
+#include "spinlock.h"
+
+#define NKMEMCACHE   16   // maximum number of caches
+#define CPUCACHESIZE 8    // objects kept on each CPU's stack
+
+struct slab {
+  struct slab *next;         // next slab with free objects
+  struct kmem_cache *cache;  // cache this slab belongs to
+  void *freelist;            // free objects in this slab
+  uint inuse;                // objects handed out from this slab
+};
+
+struct kmem_cpucache {
+  int n;                     // number of objects in objs[]
+  void *objs[CPUCACHESIZE];
+};
+
+struct kmem_cache {
+  struct spinlock lock;
+  char *name;
+  uint size;                 // object size, rounded up to 4 bytes
+  uint perslab;              // objects per slab
+  void (*ctor)(void*);       // constructor, may be 0
+  struct slab *partial;      // slabs with at least one free object
+  uint nslab;                // slabs allocated from kalloc
+  uint nfree;                // free objects in slabs (not per-CPU)
+  struct kmem_cpucache cpucache[NCPU];
+};
+
+static struct kmem_cache kmem_caches[NKMEMCACHE];
+static int nkmem_cache;
+
+// Create a cache of objects of the given size.
+// Called while the kernel is booting, before other CPUs start.
+struct kmem_cache*
+kmem_cache_create(char *name, uint size, void (*ctor)(void*))
+{
+  struct kmem_cache *c;
+
+  if(nkmem_cache >= NKMEMCACHE)
+    panic("kmem_cache_create: too many caches");
+  size = (size + 3) & ~3;
+  if(size < sizeof(void*) || sizeof(struct slab) + size > PGSIZE)
+    panic("kmem_cache_create: bad size");
+
+  c = &kmem_caches[nkmem_cache++];
+  initlock(&c->lock, name);
+  c->name = name;
+  c->size = size;
+  c->perslab = (PGSIZE - sizeof(struct slab)) / size;
+  c->ctor = ctor;
+  return c;
+}
+
+// Take a fresh page from kalloc and cut it into objects.
+// Caller must hold c->lock.
+static struct slab*
+slab_grow(struct kmem_cache *c)
+{
+  struct slab *s;
+  char *obj;
+  int i;
+
+  if((s = (struct slab*)kalloc()) == 0)
+    return 0;
+  s->cache = c;
+  s->inuse = 0;
+  s->freelist = 0;
+  obj = (char*)s + sizeof(struct slab);
+  for(i = 0; i < c->perslab; i++, obj += c->size){
+    if(c->ctor)
+      c->ctor(obj);
+    *(void**)obj = s->freelist;
+    s->freelist = obj;
+  }
+  s->next = c->partial;
+  c->partial = s;
+  c->nslab++;
+  c->nfree += c->perslab;
+  return s;
+}
+
+// Take one object out of the slabs.  Caller must hold c->lock.
+static void*
+slab_get(struct kmem_cache *c)
+{
+  struct slab *s;
+  void *obj;
+
+  if((s = c->partial) == 0 && (s = slab_grow(c)) == 0)
+    return 0;
+  obj = s->freelist;
+  s->freelist = *(void**)obj;
+  s->inuse++;
+  c->nfree--;
+  if(s->freelist == 0)
+    c->partial = s->next;  // slab is full now
+  return obj;
+}
+
+// Give one object back to its slab.  Caller must hold c->lock.
+// A slab that becomes empty goes back to kalloc, unless it is
+// the only slab with free objects left.
+static void
+slab_put(struct kmem_cache *c, void *obj)
+{
+  struct slab *s, **pp;
+
+  s = (struct slab*)PGROUNDDOWN((uint)obj);
+  if(s->cache != c)
+    panic("kmem_cache_free: wrong cache");
+  if(s->freelist == 0){
+    // was full: put it back on the partial list.
+    s->next = c->partial;
+    c->partial = s;
+  }
+  *(void**)obj = s->freelist;
+  s->freelist = obj;
+  s->inuse--;
+  c->nfree++;
+
+  if(s->inuse == 0 && (c->partial != s || s->next != 0)){
+    for(pp = &c->partial; *pp != s; pp = &(*pp)->next)
+      ;
+    *pp = s->next;
+    c->nslab--;
+    c->nfree -= c->perslab;
+    kfree((char*)s);
+  }
+}
+
+// Allocate one constructed object.
+// Returns 0 if the memory cannot be allocated.
+void*
+kmem_cache_alloc(struct kmem_cache *c)
+{
+  struct kmem_cpucache *cc;
+  void *obj;
+
+  pushcli();
+  cc = &c->cpucache[cpu - cpus];
+  if(cc->n == 0){
+    // Refill half of this CPU's stack in one go.
+    acquire(&c->lock);
+    while(cc->n < CPUCACHESIZE/2 && (obj = slab_get(c)) != 0)
+      cc->objs[cc->n++] = obj;
+    release(&c->lock);
+  }
+  obj = 0;
+  if(cc->n > 0)
+    obj = cc->objs[--cc->n];
+  popcli();
+  return obj;
+}
+
+// Free an object back to its cache.
+void
+kmem_cache_free(struct kmem_cache *c, void *obj)
+{
+  struct kmem_cpucache *cc;
+
+  pushcli();
+  cc = &c->cpucache[cpu - cpus];
+  if(cc->n == CPUCACHESIZE){
+    // Stack is full: hand half of it back to the slabs.
+    acquire(&c->lock);
+    while(cc->n > CPUCACHESIZE/2)
+      slab_put(c, cc->objs[--cc->n]);
+    release(&c->lock);
+  }
+  cc->objs[cc->n++] = obj;
+  popcli();
+}
+
+// Print the state of every cache to the console.  For debugging.
+// Runs when user types ^P on console, next to procdump().
+void
+kmem_cache_dump(void)
+{
+  struct kmem_cache *c;
+  int i, n;
+
+  cprintf("cache\tobjsize\tperslab\tbytes/obj\tslabs\tinuse\n");
+  for(c = kmem_caches; c < &kmem_caches[nkmem_cache]; c++){
+    n = c->nslab * c->perslab - c->nfree;
+    for(i = 0; i < NCPU; i++)
+      n -= c->cpucache[i].n;
+    cprintf("%s\t%d\t%d\t%d\t\t%d\t%d\n", c->name, c->size, c->perslab,
+            PGSIZE / c->perslab, c->nslab, n);
+  }
+}
@@ -0,0 +1,90 @@
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "fcntl.h"
+#include "param.h"
+
+#define NITER  2000
+#define NCHILD 10
+
+// time NITER pipe()/close() pairs: one struct pipe and two
+// struct files are allocated and freed each round.
+void
+pipebench(void)
+{
+  int i, fds[2];
+  int start, ticks;
+
+  start = uptime();
+  for(i = 0; i < NITER; i++){
+    if(pipe(fds) < 0){
+      printf(1, "pipe failed at %d\n", i);
+      exit();
+    }
+    close(fds[0]);
+    close(fds[1]);
+  }
+  ticks = uptime() - start;
+  printf(1, "pipe/close: %d rounds in %d ticks\n", NITER, ticks);
+}
+
+// time NITER open()/close() pairs on the same file: one
+// struct file and one inode cache entry each round.
+void
+openbench(void)
+{
+  int i, fd;
+  int start, ticks;
+
+  start = uptime();
+  for(i = 0; i < NITER; i++){
+    if((fd = open("README", O_RDONLY)) < 0){
+      printf(1, "open failed at %d\n", i);
+      exit();
+    }
+    close(fd);
+  }
+  ticks = uptime() - start;
+  printf(1, "open/close: %d rounds in %d ticks\n", NITER, ticks);
+}
+
+// NCHILD processes each fill their fd table with pipes, which
+// needs more struct files than the old fixed table (100) had.
+void
+growtest(void)
+{
+  int i, j, fds[2], pid;
+
+  for(i = 0; i < NCHILD; i++){
+    pid = fork();
+    if(pid < 0){
+      printf(1, "fork failed\n");
+      exit();
+    }
+    if(pid == 0){
+      for(j = 0; j < (NOFILE - 3) / 2; j++){
+        if(pipe(fds) < 0){
+          printf(1, "child %d: pipe %d failed\n", i, j);
+          exit();
+        }
+      }
+      sleep(50);
+      exit();
+    }
+  }
+  for(i = 0; i < NCHILD; i++)
+    wait();
+  printf(1, "%d processes held %d open files at once\n",
+         NCHILD, NCHILD * ((NOFILE - 3) / 2) * 2);
+}
+
+int
+main(int argc, char *argv[])
+{
+  printf(1, "slabtest starting\n");
+  pipebench();
+  openbench();
+  growtest();
+  printf(1, "slabtest ok (type ^P for per-cache memory use)\n");
+  exit();
+}
@@ -52,5 +52,17 @@ holdingsleep(struct sleeplock *lk)
   return r;
 }
 
+// Whether the current process holds lk.
+int
+holdingsleepself(struct sleeplock *lk)
+{
+  int r;
+
+  acquire(&lk->lk);
+  r = lk->locked && lk->pid == proc->pid;
+  release(&lk->lk);
+  return r;
+}
+
 
 
@@ -0,0 +1,157 @@
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "param.h"
+
+#define FRAME   1024                   // bytes of locals per call
+#define CALL    (FRAME + 64)           // stack a call takes, with saved registers
+#define DEPTH   (STACKLIMIT / CALL - 16)   // fits below the guard page
+#define NTHREAD 8
+
+// recurse n deep with FRAME bytes of locals in each call.
+int
+recurse(int n)
+{
+  char buf[FRAME];
+  int i;
+
+  for(i = 0; i < FRAME; i += 512)
+    buf[i] = n;
+  if(n == 0)
+    return 0;
+  return buf[0] + recurse(n - 1) - buf[FRAME - 512];
+}
+
+// deep recursion on the main stack, paid for as it is touched.
+void
+maintest(void)
+{
+  int before;
+
+  before = freemem();
+  recurse(DEPTH);
+  printf(1, "main stack: depth %d, %d pages\n", DEPTH, before - freemem());
+}
+
+void*
+deepthread(void *arg)
+{
+  recurse(DEPTH);
+  thread_exit(0);
+}
+
+// the same on a thread's stack.
+void
+threadtest(void)
+{
+  thread_t t;
+  void *ret;
+
+  if(thread_create(&t, deepthread, 0) != 0){
+    printf(1, "thread_create failed\n");
+    exit();
+  }
+  thread_join(t, &ret);
+  printf(1, "thread stack: depth %d\n", DEPTH);
+}
+
+// run f in a child and report whether it lived to return.
+void
+survives(char *name, void (*f)(void))
+{
+  int fd[2], pid, n;
+  char c;
+
+  if(pipe(fd) < 0 || (pid = fork()) < 0){
+    printf(1, "pipe or fork failed\n");
+    exit();
+  }
+  if(pid == 0){
+    close(fd[0]);
+    f();
+    write(fd[1], "k", 1);
+    exit();
+  }
+  close(fd[1]);
+  n = read(fd[0], &c, 1);
+  close(fd[0]);
+  wait();
+  if(n != 1){
+    printf(1, "%s: killed, stacktest failed\n", name);
+    exit();
+  }
+  printf(1, "%s ok\n", name);
+}
+
+// unbounded recursion stops at the guard page: the child is
+// killed and the parent goes on.
+void
+guardtest(void)
+{
+  int pid;
+
+  pid = fork();
+  if(pid < 0){
+    printf(1, "fork failed\n");
+    exit();
+  }
+  if(pid == 0){
+    recurse(2 * STACKLIMIT / CALL);
+    printf(1, "guard page missed!\n");
+    exit();
+  }
+  wait();
+  printf(1, "guard page ok\n");
+}
+
+int pfd[2];
+
+void*
+idlethread(void *arg)
+{
+  char c;
+
+  read(pfd[0], &c, 1);
+  thread_exit(0);
+}
+
+// free pages used by NTHREAD threads that barely touch their
+// stacks.
+void
+footprint(void)
+{
+  thread_t t[NTHREAD];
+  void *ret;
+  int i, before, during;
+
+  if(pipe(pfd) < 0){
+    printf(1, "pipe failed\n");
+    exit();
+  }
+  before = freemem();
+  for(i = 0; i < NTHREAD; i++){
+    if(thread_create(&t[i], idlethread, 0) != 0){
+      printf(1, "thread_create failed\n");
+      exit();
+    }
+  }
+  during = freemem();
+  write(pfd[1], "xxxxxxxx", NTHREAD);
+  for(i = 0; i < NTHREAD; i++)
+    thread_join(t[i], &ret);
+  close(pfd[0]);
+  close(pfd[1]);
+  printf(1, "%d idle threads: %d pages\n", NTHREAD, before - during);
+}
+
+int
+main(int argc, char *argv[])
+{
+  printf(1, "stacktest starting\n");
+  survives("main stack", maintest);
+  survives("thread stack", threadtest);
+  guardtest();
+  footprint();
+  printf(1, "stacktest ok\n");
+  exit();
+}
@@ -16,12 +16,15 @@
 int
 main(int argc, char *argv[])
 {
-  int fd, i;
+  int fd, i, t;
+  uint intr0, xfer0, cyc0, intr, xfer, cyc;
   char path[] = "stressfs0";
   char data[512];
 
   printf(1, "stressfs starting\n");
   memset(data, 'a', sizeof(data));
+  idestat(&intr0, &xfer0, &cyc0);
+  t = uptime();
 
   for(i = 0; i < 4; i++)
     if(fork() > 0)
@@ -45,5 +48,11 @@ main(int argc, char *argv[])
 
   wait();
 
+  if(path[8] == '0'){
+    idestat(&intr, &xfer, &cyc);
+    printf(1, "stressfs: %d ticks, %d disk interrupts for %d blocks\n",
+           uptime() - t, intr - intr0, xfer - xfer0);
+  }
+
   exit();
 }
@@ -0,0 +1,206 @@
+// Swapping of user pages.
+//
+// mkfs leaves SWAPSIZE blocks past the end of the file system
+// (sb.swapstart, sb.nswap), used as page-sized swap slots.  When
+// no page is free for a user page, kallocswap() first drops page
+// cache pages that nobody maps, then writes a user page chosen by
+// a clock over all address spaces (swapvictim in proc.c) to a
+// slot and frees it.  The page's PTE keeps PTE_U and PTE_W but
+// has PTE_P cleared and PTE_SWAP set, with the slot number in the
+// address bits; pagefault() reads the page back in (swapin).
+//
+// Slots are reference counted, since fork() shares a swapped-out
+// page's slot with the child.  A slot is busy while its page is
+// being written; swapin() waits for that to finish.
+//
+// The clock only takes pages from address spaces that no CPU is
+// running in, and whose kernel code is not in the middle of
+// using its PTEs: pinuvm() marks the latter.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "memlayout.h"
+#include "mmu.h"
+#include "proc.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "fs.h"
+#include "buf.h"
+
+#define NSLOT (SWAPSIZE / (PGSIZE / BSIZE))
+
+static struct {
+  struct spinlock lock;
+  uint dev;
+  uint start;          // first swap block
+  uint nslot;          // 0 until swapinit()
+  uchar ref[NSLOT];    // PTEs pointing at the slot
+  uchar busy[NSLOT];   // page being written
+  uint nout;           // pages written out, for swapstat()
+  uint nin;            // pages read back in
+} swap;
+
+void
+swapinit(int dev)
+{
+  struct superblock sb;
+
+  initlock(&swap.lock, "swap");
+  readsb(dev, &sb);
+  swap.dev = dev;
+  swap.start = sb.swapstart;
+  swap.nslot = sb.nswap / (PGSIZE / BSIZE);
+  if(swap.nslot > NSLOT)
+    swap.nslot = NSLOT;
+  cprintf("swap: %d pages at block %d\n", swap.nslot, swap.start);
+}
+
+// Allocate a slot for a page about to be written out.
+// Returns the slot, busy and with one reference, or -1.
+static int
+swapalloc(void)
+{
+  int i;
+
+  acquire(&swap.lock);
+  for(i = 0; i < swap.nslot; i++){
+    if(swap.ref[i] == 0 && !swap.busy[i]){
+      swap.ref[i] = 1;
+      swap.busy[i] = 1;
+      release(&swap.lock);
+      return i;
+    }
+  }
+  release(&swap.lock);
+  return -1;
+}
+
+// Add a reference to slot, for a PTE copied by fork().
+void
+swapdup(uint slot)
+{
+  acquire(&swap.lock);
+  if(swap.ref[slot] == 0 || swap.ref[slot] == 0xff)
+    panic("swapdup");
+  swap.ref[slot]++;
+  release(&swap.lock);
+}
+
+// Drop a reference to slot.  The last one frees it.
+void
+swapfree(uint slot)
+{
+  acquire(&swap.lock);
+  if(swap.ref[slot] == 0)
+    panic("swapfree");
+  swap.ref[slot]--;
+  release(&swap.lock);
+}
+
+// Read or write the page in slot.
+static void
+swaprw(uint slot, char *page, int write)
+{
+  struct buf b;
+  int i;
+
+  initsleeplock(&b.lock, "swapbuf");
+  acquiresleep(&b.lock);
+  b.dev = swap.dev;
+  for(i = 0; i < PGSIZE / BSIZE; i++){
+    b.blockno = swap.start + slot * (PGSIZE / BSIZE) + i;
+    b.data = (uchar*)page + i*BSIZE;
+    b.flags = write ? B_VALID | B_DIRTY : 0;
+    iderw(&b);
+  }
+  releasesleep(&b.lock);
+}
+
+// Write one user page out to swap and free it.
+// Returns 0 if no page could be swapped out.
+static int
+swapout(void)
+{
+  pde_t *pgdir;
+  char *page;
+  int slot;
+
+  if((slot = swapalloc()) < 0)
+    return 0;
+  if((page = swapvictim(slot, &pgdir)) == 0){
+    acquire(&swap.lock);
+    swap.ref[slot] = 0;
+    swap.busy[slot] = 0;
+    release(&swap.lock);
+    return 0;
+  }
+  // The owner may still have the page in its TLB.
+  tlbshootdown(pgdir);
+  swaprw(slot, page, 1);
+  acquire(&swap.lock);
+  swap.busy[slot] = 0;
+  swap.nout++;
+  wakeup(&swap.busy[slot]);
+  release(&swap.lock);
+  kfree(page);
+  return 1;
+}
+
+// Read the page in slot into page, for a PTE whose reference the
+// caller holds.  Waits for the slot to be written first.
+void
+swapin(uint slot, char *page)
+{
+  acquire(&swap.lock);
+  while(swap.busy[slot])
+    sleep(&swap.busy[slot], &swap.lock);
+  swap.nin++;
+  release(&swap.lock);
+  swaprw(slot, page, 0);
+}
+
+// Allocate a page for user memory like kalloc(), but when
+// memory runs out make room by dropping unused page cache pages
+// or swapping out user pages.  Sleeps, unless the caller holds a
+// spinlock, in which case this is just kalloc().
+char*
+kallocswap(void)
+{
+  char *mem;
+
+  while((mem = kalloc()) == 0){
+    if(cpu->ncli > 0 || swap.nslot == 0)
+      return 0;
+    if(pcacheshrink() == 0 && swapout() == 0){
+      cprintf("kallocswap: out of memory and swap\n");
+      return 0;
+    }
+  }
+  return mem;
+}
+
+// Keep the clock away from the current address space while the
+// kernel uses its PTEs without holding mm.lock.
+void
+pinuvm(void)
+{
+  proc->vmpin++;
+}
+
+void
+unpinuvm(void)
+{
+  if(--proc->vmpin < 0)
+    panic("unpinuvm");
+}
+
+// Swap traffic so far, for swapstat().
+void
+swapstat(uint *out, uint *in)
+{
+  acquire(&swap.lock);
+  *out = swap.nout;
+  *in = swap.nin;
+  release(&swap.lock);
+}
@@ -0,0 +1,53 @@
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "param.h"
+
+#define NPASS 4
+#define SWAPPAGES (SWAPSIZE / 8)  // 8 blocks per page
+
+// Write one word in each of npage heap pages, NPASS times, and
+// report pages touched per tick and the swap traffic.
+void
+run(int npage)
+{
+  char *p;
+  int i, j, start, ticks;
+  uint out0, in0, out1, in1;
+
+  p = sbrk(npage * 4096);
+  if(p == (char*)-1){
+    printf(1, "%d pages: sbrk failed\n", npage);
+    return;
+  }
+  swapstat(&out0, &in0);
+  start = uptime();
+  for(i = 0; i < NPASS; i++)
+    for(j = 0; j < npage; j++)
+      p[j * 4096] += i;
+  ticks = uptime() - start;
+  swapstat(&out1, &in1);
+  printf(1, "%d pages (%d MB): %d ticks, %d pages/tick, %d out %d in\n",
+         npage, npage / 256, ticks, npage * NPASS / (ticks ? ticks : 1),
+         out1 - out0, in1 - in0);
+  sbrk(-npage * 4096);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int free;
+
+  free = freemem();
+  printf(1, "swapbench starting: %d pages free, %d pages of swap\n",
+         free, SWAPPAGES);
+  // Working sets from well inside memory to most of memory+swap.
+  run(free / 4);
+  run(free / 2);
+  run(free - free / 8);
+  run(free + SWAPPAGES / 8);
+  run(free + SWAPPAGES / 4);
+  run(free + SWAPPAGES / 2);
+  printf(1, "swapbench done\n");
+  exit();
+}
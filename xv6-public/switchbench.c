@@ -0,0 +1,95 @@
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+
+#define NROUND 5000
+
+// Two pipes make a ping-pong: every round trip is two context
+// switches, either between two LWPs sharing one pgdir (no %cr3
+// reload) or between two processes (a %cr3 reload each way).
+int ping[2], pong[2];
+
+void
+echo(void)
+{
+  char c;
+  int i;
+
+  for(i = 0; i < NROUND; i++){
+    if(read(ping[0], &c, 1) != 1)
+      break;
+    write(pong[1], &c, 1);
+  }
+}
+
+void*
+echothread(void *arg)
+{
+  echo();
+  thread_exit(0);
+}
+
+// time NROUND round trips and print the result.
+void
+bounce(char *what)
+{
+  char c;
+  int i, start, ticks;
+
+  start = uptime();
+  for(i = 0; i < NROUND; i++){
+    write(ping[1], "x", 1);
+    if(read(pong[0], &c, 1) != 1){
+      printf(1, "%s: read failed at %d\n", what, i);
+      return;
+    }
+  }
+  ticks = uptime() - start;
+  printf(1, "%s: %d round trips in %d ticks\n", what, NROUND, ticks);
+}
+
+void
+threadbench(void)
+{
+  thread_t t;
+  void *ret;
+
+  if(thread_create(&t, echothread, 0) != 0){
+    printf(1, "thread_create failed\n");
+    return;
+  }
+  bounce("thread switch");
+  thread_join(t, &ret);
+}
+
+void
+procbench(void)
+{
+  int pid;
+
+  pid = fork();
+  if(pid < 0){
+    printf(1, "fork failed\n");
+    return;
+  }
+  if(pid == 0){
+    echo();
+    exit();
+  }
+  bounce("process switch");
+  wait();
+}
+
+int
+main(int argc, char *argv[])
+{
+  if(pipe(ping) < 0 || pipe(pong) < 0){
+    printf(1, "pipe failed\n");
+    exit();
+  }
+  printf(1, "switchbench starting\n");
+  threadbench();
+  procbench();
+  printf(1, "switchbench done\n");
+  exit();
+}
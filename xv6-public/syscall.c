@@ -17,28 +17,16 @@
 int
 fetchint(uint addr, int *ip)
 {
-  if(addr >= proc->sz || addr+4 > proc->sz)
-    return -1;
-  *ip = *(int*)(addr);
-  return 0;
+  return copyin(ip, addr, sizeof(*ip));
 }
 
-// Fetch the nul-terminated string at addr from the current process.
-// Doesn't actually copy the string - just sets *pp to point at it.
+// Copy the nul-terminated string at addr from the current process
+// into buf, which holds max bytes.
 // Returns length of string, not including nul.
 int
-fetchstr(uint addr, char **pp)
+fetchstr(uint addr, char *buf, int max)
 {
-  char *s, *ep;
-
-  if(addr >= proc->sz)
-    return -1;
-  *pp = (char*)addr;
-  ep = (char*)proc->sz;
-  for(s = *pp; s < ep; s++)
-    if(*s == 0)
-      return s - *pp;
-  return -1;
+  return copyinstr(buf, addr, max);
 }
 
 // Fetch the nth 32-bit system call argument.
@@ -64,17 +52,16 @@ argptr(int n, char **pp, int size)
   return 0;
 }
 
-// Fetch the nth word-sized system call argument as a string pointer.
-// Check that the pointer is valid and the string is nul-terminated.
-// (There is no shared writable memory, so the string can't change
-// between this check and being used by the kernel.)
+// Fetch the nth word-sized system call argument as a string and
+// copy it into buf, which holds max bytes, so that other LWPs or
+// MAP_SHARED writers cannot change it while the kernel uses it.
 int
-argstr(int n, char **pp)
+argstr(int n, char *buf, int max)
 {
   int addr;
   if(argint(n, &addr) < 0)
     return -1;
-  return fetchstr(addr, pp);
+  return fetchstr(addr, buf, max);
 }
 
 extern int sys_chdir(void);
@@ -113,6 +100,23 @@ extern int sys_thread_create(void);
 extern int sys_thread_exit(void);
 extern int sys_thread_join(void);
 
+/* Memory */
+extern int sys_freemem(void);
+extern int sys_mmap(void);
+extern int sys_munmap(void);
+extern int sys_msync(void);
+extern int sys_swapstat(void);
+
+/* File */
+extern int sys_fcntl(void);
+extern int sys_lseek(void);
+extern int sys_freeblocks(void);
+
+/* Statistics */
+extern int sys_cswitches(void);
+extern int sys_bstat(void);
+extern int sys_idestat(void);
+
 static int (*syscalls[])(void) = {
 [SYS_fork]        sys_fork,
 [SYS_exit]        sys_exit,
@@ -149,6 +153,23 @@ static int (*syscalls[])(void) = {
 [SYS_thread_create] sys_thread_create,
 [SYS_thread_exit]   sys_thread_exit,
 [SYS_thread_join]   sys_thread_join,
+
+/* Memory */
+[SYS_freemem]       sys_freemem,
+[SYS_mmap]          sys_mmap,
+[SYS_munmap]        sys_munmap,
+[SYS_msync]         sys_msync,
+[SYS_swapstat]      sys_swapstat,
+
+/* File */
+[SYS_fcntl]         sys_fcntl,
+[SYS_lseek]         sys_lseek,
+[SYS_freeblocks]    sys_freeblocks,
+
+/* Statistics */
+[SYS_cswitches]     sys_cswitches,
+[SYS_bstat]         sys_bstat,
+[SYS_idestat]       sys_idestat,
 };
 
 void
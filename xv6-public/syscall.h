@@ -34,3 +34,20 @@
 #define SYS_thread_create 27
 #define SYS_thread_exit   28
 #define SYS_thread_join   29
+
+/* Memory */
+#define SYS_freemem       30
+#define SYS_mmap          31
+#define SYS_munmap        32
+#define SYS_msync         33
+#define SYS_swapstat      34
+
+/* File */
+#define SYS_fcntl         35
+#define SYS_lseek         39
+#define SYS_freeblocks    40
+
+/* Statistics */
+#define SYS_cswitches     36
+#define SYS_bstat         37
+#define SYS_idestat       38
@@ -0,0 +1,111 @@
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "fcntl.h"
+
+#define NCALL 10000
+#define SMALL 16
+
+char buf[4096];
+
+void
+report(char *what, int start)
+{
+  printf(1, "%s: %d calls in %d ticks\n", what, NCALL, uptime() - start);
+}
+
+// SMALL-byte writes, then SMALL-byte reads of the same file.
+void
+smallrw(char *path)
+{
+  int fd, i, start;
+
+  if((fd = open(path, O_CREATE | O_RDWR)) < 0){
+    printf(1, "syscallbench: cannot create %s\n", path);
+    exit();
+  }
+  start = uptime();
+  for(i = 0; i < NCALL; i++)
+    if(write(fd, buf, SMALL) != SMALL){
+      printf(1, "syscallbench: write failed\n");
+      exit();
+    }
+  report("small write", start);
+  close(fd);
+
+  fd = open(path, O_RDONLY);
+  start = uptime();
+  for(i = 0; i < NCALL; i++)
+    if(read(fd, buf, SMALL) != SMALL){
+      printf(1, "syscallbench: read failed\n");
+      exit();
+    }
+  report("small read", start);
+  close(fd);
+}
+
+// open and close, and stat, which copy a path in and a stat out.
+void
+openstat(char *path)
+{
+  struct stat st;
+  int fd, i, start;
+
+  start = uptime();
+  for(i = 0; i < NCALL; i++){
+    if((fd = open(path, O_RDONLY)) < 0){
+      printf(1, "syscallbench: open failed\n");
+      exit();
+    }
+    close(fd);
+  }
+  report("open/close", start);
+
+  start = uptime();
+  for(i = 0; i < NCALL; i++)
+    if(stat(path, &st) < 0 || st.size != NCALL * SMALL){
+      printf(1, "syscallbench: stat failed\n");
+      exit();
+    }
+  report("stat", start);
+}
+
+// Bad pointers make system calls fail instead of killing anyone.
+void
+badptr(char *path)
+{
+  char *hole;
+  int fd;
+
+  // Between the heap and mmap() regions nothing is mapped.
+  hole = sbrk(0) + 64*4096;
+  fd = open(path, O_RDONLY);
+  if(read(fd, hole, SMALL) != -1)
+    printf(1, "syscallbench: read into a hole succeeded\n");
+  if(write(fd, hole, SMALL) != -1)
+    printf(1, "syscallbench: write from a hole succeeded\n");
+  if(fstat(fd, (struct stat*)hole) != -1)
+    printf(1, "syscallbench: fstat into a hole succeeded\n");
+  close(fd);
+  if(open(hole, O_RDONLY) != -1)
+    printf(1, "syscallbench: open of a hole succeeded\n");
+  if(pipe((int*)hole) != -1)
+    printf(1, "syscallbench: pipe into a hole succeeded\n");
+  if(open((char*)0x80000000, O_RDONLY) != -1)
+    printf(1, "syscallbench: open of a kernel address succeeded\n");
+  printf(1, "bad pointers ok\n");
+}
+
+int
+main(int argc, char *argv[])
+{
+  char *path = (argc > 1) ? argv[1] : "syscallfile";
+
+  printf(1, "syscallbench starting\n");
+  smallrw(path);
+  openstat(path);
+  badptr(path);
+  unlink(path);
+  printf(1, "syscallbench done\n");
+  exit();
+}
@@ -15,6 +15,7 @@
 #include "sleeplock.h"
 #include "file.h"
 #include "fcntl.h"
+#include "mman.h"
 
 // Fetch the nth word-sized system call argument as a file descriptor
 // and return both the descriptor and the corresponding struct file.
@@ -65,30 +66,88 @@ sys_dup(void)
   return fd;
 }
 
+#define FILECHUNK (16*PGSIZE)  // bytes of a file read or write pinned at once
+
+// Pipes and the console copy with a spinlock held, and readi()
+// and writei() copy with a buffer locked, when a fault on a page
+// mapped from the same block would deadlock.  So the user pages
+// must be there and stay there (see swap.c).  sys_read and
+// sys_write fault them in and pin them one chunk at a time, so
+// that a large buffer costs no more than the bytes moved.
+static int
+iochunk(struct file *f)
+{
+  if(f->type == FD_PIPE)
+    return pipesize(f->pipe);
+  if(f->ip->type == T_DEV)
+    return PGSIZE;
+  return FILECHUNK;
+}
+
 int
 sys_read(void)
 {
   struct file *f;
-  int n;
+  int n, m, r, done;
   char *p;
 
   if(argfd(0, 0, &f) < 0 || argint(2, &n) < 0 || argptr(1, &p, n) < 0)
     return -1;
-  return fileread(f, p, n);
+  if(f->type == FD_PIPE || f->ip->type == T_DEV){
+    // One chunk: a pipe never holds more, and either may return
+    // less than asked.
+    if(n > iochunk(f))
+      n = iochunk(f);
+    if(prefault((uint)p, n, 1) < 0)
+      return -1;
+    pinuvm();
+    r = fileread(f, p, n);
+    unpinuvm();
+    return r;
+  }
+  for(done = 0; done < n; done += r){
+    m = n - done;
+    if(m > iochunk(f))
+      m = iochunk(f);
+    if(prefault((uint)p + done, m, 1) < 0)
+      return done > 0 ? done : -1;
+    pinuvm();
+    r = fileread(f, p + done, m);
+    unpinuvm();
+    if(r < 0)
+      return done > 0 ? done : -1;
+    if(r < m)
+      return done + r;
+  }
+  return n;
 }
 
 int
 sys_write(void)
 {
   struct file *f;
-  int n;
+  int n, m, r, done;
   char *p;
 
   if(argfd(0, 0, &f) < 0 || argint(2, &n) < 0)
     return -1;
   if(argptr(1, &p, n) < 0)
     return -1;
-  return filewrite(f, p, n);
+  for(done = 0; done < n; done += r){
+    m = n - done;
+    if(m > iochunk(f))
+      m = iochunk(f);
+    if(prefault((uint)p + done, m, 0) < 0)
+      return done > 0 ? done : -1;
+    pinuvm();
+    r = filewrite(f, p + done, m);
+    unpinuvm();
+    if(r < 0)
+      return done > 0 ? done : -1;
+    if(r < m)
+      return done + r;
+  }
+  return n;
 }
 
 int
@@ -108,21 +167,24 @@ int
 sys_fstat(void)
 {
   struct file *f;
-  struct stat *st;
+  struct stat st;
+  int addr;
 
-  if(argfd(0, 0, &f) < 0 || argptr(1, (void*)&st, sizeof(*st)) < 0)
+  if(argfd(0, 0, &f) < 0 || argint(1, &addr) < 0)
+    return -1;
+  if(filestat(f, &st) < 0)
     return -1;
-  return filestat(f, st);
+  return copyout(proc->pgdir, addr, &st, sizeof(st));
 }
 
 // Create the path new as a link to the same inode as old.
 int
 sys_link(void)
 {
-  char name[DIRSIZ], *new, *old;
+  char name[DIRSIZ], new[MAXPATH], old[MAXPATH];
   struct inode *dp, *ip;
 
-  if(argstr(0, &old) < 0 || argstr(1, &new) < 0)
+  if(argstr(0, old, sizeof(old)) < 0 || argstr(1, new, sizeof(new)) < 0)
     return -1;
 
   begin_op();
@@ -187,10 +249,10 @@ sys_unlink(void)
 {
   struct inode *ip, *dp;
   struct dirent de;
-  char name[DIRSIZ], *path;
+  char name[DIRSIZ], path[MAXPATH];
   uint off;
 
-  if(argstr(0, &path) < 0)
+  if(argstr(0, path, sizeof(path)) < 0)
     return -1;
 
   begin_op();
@@ -287,12 +349,12 @@ create(char *path, short type, short major, short minor)
 int
 sys_open(void)
 {
-  char *path;
+  char path[MAXPATH];
   int fd, omode;
   struct file *f;
   struct inode *ip;
 
-  if(argstr(0, &path) < 0 || argint(1, &omode) < 0)
+  if(argstr(0, path, sizeof(path)) < 0 || argint(1, &omode) < 0)
     return -1;
 
   begin_op();
@@ -329,6 +391,9 @@ sys_open(void)
   f->type = FD_INODE;
   f->ip = ip;
   f->off = 0;
+  f->raoff = 0;
+  f->rawin = 0;
+  f->ranext = 0;
   f->readable = !(omode & O_WRONLY);
   f->writable = (omode & O_WRONLY) || (omode & O_RDWR);
   return fd;
@@ -337,11 +402,11 @@ sys_open(void)
 int
 sys_mkdir(void)
 {
-  char *path;
+  char path[MAXPATH];
   struct inode *ip;
 
   begin_op();
-  if(argstr(0, &path) < 0 || (ip = create(path, T_DIR, 0, 0)) == 0){
+  if(argstr(0, path, sizeof(path)) < 0 || (ip = create(path, T_DIR, 0, 0)) == 0){
     end_op();
     return -1;
   }
@@ -354,11 +419,11 @@ int
 sys_mknod(void)
 {
   struct inode *ip;
-  char *path;
+  char path[MAXPATH];
   int major, minor;
 
   begin_op();
-  if((argstr(0, &path)) < 0 ||
+  if((argstr(0, path, sizeof(path))) < 0 ||
      argint(1, &major) < 0 ||
      argint(2, &minor) < 0 ||
      (ip = create(path, T_DEV, major, minor)) == 0){
@@ -373,11 +438,11 @@ sys_mknod(void)
 int
 sys_chdir(void)
 {
-  char *path;
+  char path[MAXPATH];
   struct inode *ip;
 
   begin_op();
-  if(argstr(0, &path) < 0 || (ip = namei(path)) == 0){
+  if(argstr(0, path, sizeof(path)) < 0 || (ip = namei(path)) == 0){
     end_op();
     return -1;
   }
@@ -397,37 +462,48 @@ sys_chdir(void)
 int
 sys_exec(void)
 {
-  char *path, *argv[MAXARG];
-  int i;
+  char path[MAXPATH], *argv[MAXARG], *page, *s;
+  int i, n, r;
   uint uargv, uarg;
 
-  if(argstr(0, &path) < 0 || argint(1, (int*)&uargv) < 0){
+  if(argstr(0, path, sizeof(path)) < 0 || argint(1, (int*)&uargv) < 0){
     return -1;
   }
+  // The strings are copied to one page: exec() must fit them
+  // into the new stack's page anyway.
+  if((page = kalloc()) == 0)
+    return -1;
+  s = page;
+  r = -1;
   memset(argv, 0, sizeof(argv));
   for(i=0;; i++){
     if(i >= NELEM(argv))
-      return -1;
+      goto out;
     if(fetchint(uargv+4*i, (int*)&uarg) < 0)
-      return -1;
+      goto out;
     if(uarg == 0){
       argv[i] = 0;
       break;
     }
-    if(fetchstr(uarg, &argv[i]) < 0)
-      return -1;
+    if((n = fetchstr(uarg, s, page + PGSIZE - s)) < 0)
+      goto out;
+    argv[i] = s;
+    s += n + 1;
   }
-  return exec(path, argv);
+  r = exec(path, argv);
+out:
+  kfree(page);
+  return r;
 }
 
 int
 sys_pipe(void)
 {
-  int *fd;
+  int fd[2], addr;
   struct file *rf, *wf;
   int fd0, fd1;
 
-  if(argptr(0, (void*)&fd, 2*sizeof(fd[0])) < 0)
+  if(argint(0, &addr) < 0)
     return -1;
   if(pipealloc(&rf, &wf) < 0)
     return -1;
@@ -441,5 +517,113 @@ sys_pipe(void)
   }
   fd[0] = fd0;
   fd[1] = fd1;
+  if(copyout(proc->pgdir, addr, fd, sizeof(fd)) < 0){
+    proc->ofile[fd0] = 0;
+    proc->ofile[fd1] = 0;
+    fileclose(rf);
+    fileclose(wf);
+    return -1;
+  }
   return 0;
 }
+
+// fcntl(fd, cmd, arg); only pipe sizes so far.
+int
+sys_fcntl(void)
+{
+  struct file *f;
+  int cmd, arg;
+
+  if(argfd(0, 0, &f) < 0 || argint(1, &cmd) < 0 || argint(2, &arg) < 0)
+    return -1;
+  if(f->type != FD_PIPE)
+    return -1;
+  switch(cmd){
+  case F_GETPIPE_SZ:
+    return pipesize(f->pipe);
+  case F_SETPIPE_SZ:
+    return pipesetsize(f->pipe, arg);
+  }
+  return -1;
+}
+
+// lseek(fd, off, whence): move a file's offset, but not past
+// its end, since files here have no holes.
+int
+sys_lseek(void)
+{
+  struct file *f;
+  int off, whence;
+  uint base;
+
+  if(argfd(0, 0, &f) < 0 || argint(1, &off) < 0 || argint(2, &whence) < 0)
+    return -1;
+  if(f->type != FD_INODE)
+    return -1;
+  ilock(f->ip);
+  switch(whence){
+  case SEEK_SET:
+    base = 0;
+    break;
+  case SEEK_CUR:
+    base = f->off;
+    break;
+  case SEEK_END:
+    base = f->ip->size;
+    break;
+  default:
+    iunlock(f->ip);
+    return -1;
+  }
+  if((int)base + off < 0 || base + off > f->ip->size){
+    iunlock(f->ip);
+    return -1;
+  }
+  f->off = base + off;
+  iunlock(f->ip);
+  return f->off;
+}
+
+// the number of free blocks on the disk
+int
+sys_freeblocks(void)
+{
+  return nfreeblocks();
+}
+
+// mmap(addr, len, prot, flags, fd, off); fd is ignored
+// with MAP_ANONYMOUS.
+int
+sys_mmap(void)
+{
+  struct file *f;
+  int addr, len, prot, flags, off;
+
+  if(argint(0, &addr) < 0 || argint(1, &len) < 0 || argint(2, &prot) < 0 ||
+     argint(3, &flags) < 0 || argint(5, &off) < 0)
+    return -1;
+  f = 0;
+  if(!(flags & MAP_ANONYMOUS) && argfd(4, 0, &f) < 0)
+    return -1;
+  return mmap(addr, len, prot, flags, f, off);
+}
+
+int
+sys_munmap(void)
+{
+  int addr, len;
+
+  if(argint(0, &addr) < 0 || argint(1, &len) < 0)
+    return -1;
+  return munmap(addr, len);
+}
+
+int
+sys_msync(void)
+{
+  int addr, len;
+
+  if(argint(0, &addr) < 0 || argint(1, &len) < 0)
+    return -1;
+  return msync(addr, len);
+}
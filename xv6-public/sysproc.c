@@ -159,3 +159,67 @@ sys_thread_join(void)
   return thread_join(thread, retval);
 }
 
+
+// return the number of free physical pages
+int
+sys_freemem(void)
+{
+  return kfreepages();
+}
+
+// pages swapped out and in so far
+int
+sys_swapstat(void)
+{
+  int out, in;
+  uint nout, nin;
+
+  if(argint(0, &out) < 0 || argint(1, &in) < 0)
+    return -1;
+  swapstat(&nout, &nin);
+  if(copyout(proc->pgdir, out, &nout, sizeof(nout)) < 0 ||
+     copyout(proc->pgdir, in, &nin, sizeof(nin)) < 0)
+    return -1;
+  return 0;
+}
+
+// return the number of context switches so far
+int
+sys_cswitches(void)
+{
+  return cswitches();
+}
+
+// block cache hits and misses so far
+int
+sys_bstat(void)
+{
+  int hit, miss;
+  uint nhit, nmiss;
+
+  if(argint(0, &hit) < 0 || argint(1, &miss) < 0)
+    return -1;
+  bstat(&nhit, &nmiss);
+  if(copyout(proc->pgdir, hit, &nhit, sizeof(nhit)) < 0 ||
+     copyout(proc->pgdir, miss, &nmiss, sizeof(nmiss)) < 0)
+    return -1;
+  return 0;
+}
+
+// disk interrupts, bufs moved, and driver cycles so far
+int
+sys_idestat(void)
+{
+  int intr, xfer, cycles;
+  uint nintr, nxfer, ncycles;
+
+  if(argint(0, &intr) < 0 || argint(1, &xfer) < 0 ||
+     argint(2, &cycles) < 0)
+    return -1;
+  idestat(&nintr, &nxfer, &ncycles);
+  if(copyout(proc->pgdir, intr, &nintr, sizeof(nintr)) < 0 ||
+     copyout(proc->pgdir, xfer, &nxfer, sizeof(nxfer)) < 0 ||
+     copyout(proc->pgdir, cycles, &ncycles, sizeof(ncycles)) < 0)
+    return -1;
+  return 0;
+}
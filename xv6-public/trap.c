@@ -11,6 +11,7 @@
 // Interrupt descriptor table (shared by all CPUs).
 struct gatedesc idt[256];
 extern uint vectors[];  // in vectors.S: array of 256 entry pointers
+extern char ucopybegin[], ucopyend[], ucopyfail[];  // in usercopy.S
 struct spinlock tickslock;
 uint ticks;
 
@@ -39,6 +40,8 @@ extern const int quantum[];
 void
 trap(struct trapframe *tf)
 {
+  uint va;
+
   if(tf->trapno == 128){
     cprintf("user interrupt 128 called!\n");
     return;
@@ -85,6 +88,10 @@ trap(struct trapframe *tf)
     uartintr();
     lapiceoi();
     break;
+  case T_IRQ0 + IRQ_TLB:
+    tlbintr();
+    lapiceoi();
+    break;
   case T_IRQ0 + 7:
   case T_IRQ0 + IRQ_SPURIOUS:
     cprintf("cpu%d: spurious interrupt at %x:%x\n",
@@ -92,8 +99,26 @@ trap(struct trapframe *tf)
     lapiceoi();
     break;
 
+  case T_PGFLT:
+    // mmap() regions are filled in on first touch.
+    va = rcr2();
+    if(pagefault(va, tf->err) == 0)
+      break;
+    // A bad user address makes ucopy() and ucopystr() fail.
+    if((tf->cs&3) == 0 && va < KERNBASE &&
+       tf->eip >= (uint)ucopybegin && tf->eip < (uint)ucopyend){
+      tf->eip = (uint)ucopyfail;
+      break;
+    }
+    // fall through
+
   //PAGEBREAK: 13
   default:
+    if(virtioirq && tf->trapno == T_IRQ0 + virtioirq){
+      virtiointr();
+      lapiceoi();
+      break;
+    }
     if(proc == 0 || (tf->cs&3) == 0){
       // In kernel, it must be our mistake.
       cprintf("unexpected trap %d from cpu %d eip %x (cr2=0x%x)\n",
@@ -33,13 +33,6 @@ strlen(char *s)
   return n;
 }
 
-void*
-memset(void *dst, int c, uint n)
-{
-  stosb(dst, c, n);
-  return dst;
-}
-
 char*
 strchr(const char *s, char c)
 {
@@ -92,14 +85,3 @@ atoi(const char *s)
   return n;
 }
 
-void*
-memmove(void *vdst, void *vsrc, int n)
-{
-  char *dst, *src;
-
-  dst = vdst;
-  src = vsrc;
-  while(n-- > 0)
-    *dst++ = *src++;
-  return vdst;
-}
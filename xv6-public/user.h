@@ -38,6 +38,23 @@ int thread_create(thread_t*, void* (*)(void*), void*);
 void thread_exit(void*) __attribute__((noreturn));
 int thread_join(thread_t, void**);
 
+/* Memory */
+int freemem(void);
+char* mmap(void*, uint, int, int, int, uint);
+int munmap(void*, uint);
+int msync(void*, uint);
+int swapstat(uint*, uint*);
+
+/* File */
+int fcntl(int, int, int);
+int lseek(int, int, int);
+int freeblocks(void);
+
+/* Statistics */
+int cswitches(void);
+int bstat(uint*, uint*);
+int idestat(uint*, uint*, uint*);
+
 // ulib.c
 int stat(char*, struct stat*);
 char* strcpy(char*, char*);
@@ -48,6 +65,7 @@ void printf(int, char*, ...);
 char* gets(char*, int max);
 uint strlen(char*);
 void* memset(void*, int, uint);
+int memcmp(const void*, const void*, uint);
 void* malloc(uint);
 void free(void*);
 int atoi(const char*);
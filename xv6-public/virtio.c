@@ -0,0 +1,314 @@
+// Driver for a virtio block device on the PCI bus, through the
+// legacy (virtio 0.9.5) interface that QEMU offers with
+// -device virtio-blk-pci,disable-modern=on.  When it is present
+// it stands in for IDE disk 1: bio_submit() and iderw() hand disk
+// 1's requests to virtio_submit() and virtiorw().
+//
+// Each request is a chain of three descriptors: header, data, and
+// status byte.  As many requests are in flight as the queue has
+// room for.  Requests that find no free descriptors wait on
+// vio.pending and start as others finish, so submitting never
+// sleeps and is fine from a completion handler.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "memlayout.h"
+#include "mmu.h"
+#include "proc.h"
+#include "x86.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "fs.h"
+#include "buf.h"
+#include "pci.h"
+
+#define VIRTIO_VENDOR   0x1af4
+#define VIRTIO_BLK      0x1001  // transitional block device
+
+// Legacy registers, from the I/O ports in BAR0.
+#define VIO_GUESTFEAT   4
+#define VIO_QADDR       8       // page number of the queue
+#define VIO_QSIZE       12
+#define VIO_QSEL        14
+#define VIO_QNOTIFY     16
+#define VIO_STATUS      18
+#define VIO_ISR         19      // reading acknowledges the interrupt
+#define VIO_CAPACITY    20      // 512-byte sectors, 64 bits
+
+#define VIO_ACK         1
+#define VIO_DRIVER      2
+#define VIO_DRIVER_OK   4
+#define VIO_FAILED      128
+
+#define VRING_NEXT      1
+#define VRING_WRITE     2       // the device writes this buffer
+
+#define VIO_BLK_IN      0
+#define VIO_BLK_OUT     1
+
+#define NVDESC          256     // largest queue vqmem holds
+
+struct vdesc {
+  uint addr;
+  uint addrhi;
+  uint len;
+  ushort flags;
+  ushort next;
+};
+
+struct vavail {
+  ushort flags;
+  ushort idx;
+  ushort ring[];
+};
+
+struct vusedelem {
+  uint id;    // head descriptor of the finished chain
+  uint len;
+};
+
+struct vused {
+  ushort flags;
+  ushort idx;
+  struct vusedelem ring[];
+};
+
+// What a request's header and status descriptors point at.
+struct vreq {
+  uint type;
+  uint reserved;
+  uint sector;
+  uint sectorhi;
+  uchar status;
+  struct buf *b;
+};
+
+// The queue: descriptors, then the available ring, then the used
+// ring on the next page boundary.
+static char vqmem[3*PGSIZE] __attribute__((aligned(PGSIZE)));
+
+static struct {
+  struct spinlock lock;
+  ushort base;
+  int n;                    // queue size
+  uint capacity;
+  struct vdesc *desc;
+  struct vavail *avail;
+  struct vused *used;
+  ushort lastused;
+  uchar free[NVDESC];
+  int nfree;
+  struct vreq req[NVDESC];  // by head descriptor
+  struct buf *pending;      // waiting for descriptors
+  struct buf *pendtail;
+} vio;
+
+int havevirtio;
+int virtioirq;
+
+void
+virtioinit(void)
+{
+  struct pcidev d;
+  int i, n;
+
+  if(pcifind(VIRTIO_VENDOR, VIRTIO_BLK, PCI_ANY, PCI_ANY, &d) < 0 ||
+     !(d.bario & 1))
+    return;
+  initlock(&vio.lock, "virtio");
+  pcienable(&d);
+  vio.base = d.bar[0];
+
+  outb(vio.base+VIO_STATUS, 0);  // reset
+  outb(vio.base+VIO_STATUS, VIO_ACK);
+  outb(vio.base+VIO_STATUS, VIO_ACK|VIO_DRIVER);
+  outl(vio.base+VIO_GUESTFEAT, 0);
+
+  outw(vio.base+VIO_QSEL, 0);
+  n = inw(vio.base+VIO_QSIZE);
+  if(n == 0 || n > NVDESC){
+    cprintf("virtio: queue size %d\n", n);
+    outb(vio.base+VIO_STATUS, VIO_FAILED);
+    return;
+  }
+  vio.n = n;
+  vio.capacity = inl(vio.base+VIO_CAPACITY);
+  memset(vqmem, 0, sizeof(vqmem));
+  vio.desc = (struct vdesc*)vqmem;
+  vio.avail = (struct vavail*)(vqmem + n*sizeof(struct vdesc));
+  vio.used = (struct vused*)(vqmem + PGROUNDUP(n*sizeof(struct vdesc) + 6 + 2*n));
+  for(i = 0; i < n; i++)
+    vio.free[i] = 1;
+  vio.nfree = n;
+  outl(vio.base+VIO_QADDR, V2P(vqmem) >> PGSHIFT);
+
+  virtioirq = d.irq;
+  picenable(virtioirq);
+  ioapicenable(virtioirq, ncpu - 1);
+  outb(vio.base+VIO_STATUS, VIO_ACK|VIO_DRIVER|VIO_DRIVER_OK);
+  havevirtio = 1;
+  cprintf("virtio-blk: %d sectors, queue %d, irq %d\n",
+          vio.capacity, n, virtioirq);
+}
+
+static int
+valloc(void)
+{
+  int i;
+
+  for(i = 0; i < vio.n; i++){
+    if(vio.free[i]){
+      vio.free[i] = 0;
+      vio.nfree--;
+      return i;
+    }
+  }
+  panic("valloc");
+}
+
+// Give b to the device.  Caller holds vio.lock, and there are
+// three free descriptors.
+static void
+vstart(struct buf *b)
+{
+  struct vreq *r;
+  struct vdesc *d;
+  int h, i, n;
+
+  h = valloc();
+  i = valloc();
+  n = valloc();
+
+  r = &vio.req[h];
+  r->type = (b->flags & B_DIRTY) ? VIO_BLK_OUT : VIO_BLK_IN;
+  r->reserved = 0;
+  r->sector = b->blockno * (BSIZE/512);
+  r->sectorhi = 0;
+  r->status = 0xff;
+  r->b = b;
+
+  d = &vio.desc[h];
+  d->addr = V2P(r);
+  d->addrhi = 0;
+  d->len = 16;
+  d->flags = VRING_NEXT;
+  d->next = i;
+
+  d = &vio.desc[i];
+  d->addr = V2P(b->data);
+  d->addrhi = 0;
+  d->len = BSIZE;
+  d->flags = VRING_NEXT | ((b->flags & B_DIRTY) ? 0 : VRING_WRITE);
+  d->next = n;
+
+  d = &vio.desc[n];
+  d->addr = V2P(&r->status);
+  d->addrhi = 0;
+  d->len = 1;
+  d->flags = VRING_WRITE;
+  d->next = 0;
+
+  vio.avail->ring[vio.avail->idx % vio.n] = h;
+  __sync_synchronize();
+  vio.avail->idx++;
+  __sync_synchronize();
+  outw(vio.base+VIO_QNOTIFY, 0);
+}
+
+void
+virtiointr(void)
+{
+  struct buf *b, *fin, **finp;
+  struct vusedelem *e;
+  struct vreq *r;
+  void (*done)(struct buf*);
+  int i;
+
+  acquire(&vio.lock);
+  inb(vio.base+VIO_ISR);
+
+  fin = 0;
+  finp = &fin;
+  while(vio.lastused != *(volatile ushort*)&vio.used->idx){
+    __sync_synchronize();
+    e = &vio.used->ring[vio.lastused % vio.n];
+    r = &vio.req[e->id];
+    if(r->status != 0)
+      panic("virtio: request failed");
+    for(i = e->id; ; i = vio.desc[i].next){
+      vio.free[i] = 1;
+      vio.nfree++;
+      if(!(vio.desc[i].flags & VRING_NEXT))
+        break;
+    }
+    vio.lastused++;
+
+    // Wake process waiting for this buf,
+    // or save it for its handler.
+    b = r->b;
+    b->flags |= B_VALID;
+    b->flags &= ~B_DIRTY;
+    if(b->done){
+      b->qnext = 0;
+      *finp = b;
+      finp = &b->qnext;
+    } else
+      wakeup(b);
+  }
+
+  // Start waiting requests.
+  while(vio.pending && vio.nfree >= 3){
+    b = vio.pending;
+    vio.pending = b->qnext;
+    vstart(b);
+  }
+
+  release(&vio.lock);
+
+  // The handlers may submit more requests.
+  while((b = fin) != 0){
+    fin = b->qnext;
+    done = b->done;
+    b->done = 0;
+    done(b);
+  }
+}
+
+// Like bio_submit(), for the virtio disk.
+void
+virtio_submit(struct buf *b, void (*done)(struct buf*))
+{
+  if(!holdingsleep(&b->lock))
+    panic("virtio_submit: buf not locked");
+  if((b->flags & (B_VALID|B_DIRTY)) == B_VALID)
+    panic("virtio_submit: nothing to do");
+  if(b->blockno * (BSIZE/512) >= vio.capacity)
+    panic("virtio_submit: block out of range");
+
+  acquire(&vio.lock);
+  b->qnext = 0;
+  b->done = done;
+  if(vio.pending == 0 && vio.nfree >= 3)
+    vstart(b);
+  else {
+    if(vio.pending)
+      vio.pendtail->qnext = b;
+    else
+      vio.pending = b;
+    vio.pendtail = b;
+  }
+  release(&vio.lock);
+}
+
+// Like iderw(), for the virtio disk.
+void
+virtiorw(struct buf *b)
+{
+  virtio_submit(b, 0);
+
+  acquire(&vio.lock);
+  while((b->flags & (B_VALID|B_DIRTY)) != B_VALID)
+    sleep(b, &vio.lock);
+  release(&vio.lock);
+}
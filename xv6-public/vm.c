@@ -5,11 +5,35 @@
 #include "memlayout.h"
 #include "mmu.h"
 #include "proc.h"
+#include "spinlock.h"
+#include "traps.h"
 #include "elf.h"
 
 extern char data[];  // defined by kernel.ld
 pde_t *kpgdir;  // for use in scheduler()
 
+// CPUs switch page tables lazily: cpu->pgdir is whatever pgdir is
+// in %cr3, and it stays loaded after its process stops running, so
+// that switching between LWPs of one process needs no %cr3 reload.
+// A pgdir freed while another CPU still has it loaded is parked
+// here until the last such CPU switches away from it.
+static struct {
+  struct spinlock lock;
+  pde_t *pgdir[NCPU];
+} deadvm;
+
+#define NTLBBATCH 32  // unmapped pages freed per TLB shootdown
+
+// Pages unmapped from pgdir that other CPUs may still reach
+// through their TLBs; freed by tlbbatchflush().
+struct tlbbatch {
+  pde_t *pgdir;
+  int n;
+  char *page[NTLBBATCH];
+};
+
+static int unmapuvm(pde_t*, uint, uint, struct tlbbatch*);
+
 // Set up CPU's kernel segment descriptors.
 // Run once on entry on each CPU.
 void
@@ -36,18 +60,21 @@ seginit(void)
   // Initialize cpu-local storage.
   cpu = c;
   proc = 0;
+  c->pgdir = kpgdir;  // loaded by kvmalloc() or mpenter()
 }
 
 // Return the address of the PTE in page table pgdir
 // that corresponds to virtual address va.  If alloc!=0,
 // create any required page table pages.
-static pte_t *
+pte_t *
 walkpgdir(pde_t *pgdir, const void *va, int alloc)
 {
   pde_t *pde;
   pte_t *pgtab;
 
   pde = &pgdir[PDX(va)];
+  if(*pde & PTE_PS)
+    return 0;  // 4MB page: there is no page table to walk
   if(*pde & PTE_P){
     pgtab = (pte_t*)P2V(PTE_ADDR(*pde));
   } else {
@@ -76,6 +103,8 @@ mappages(pde_t *pgdir, void *va, uint size, uint pa, int perm)
   a = (char*)PGROUNDDOWN((uint)va);
   last = (char*)PGROUNDDOWN(((uint)va) + size - 1);
   for(;;){
+    if(pgdir[PDX(a)] & PTE_PS)
+      panic("remap");
     if((pte = walkpgdir(pgdir, a, 1)) == 0)
       return -1;
     if(*pte & PTE_P){
@@ -125,42 +154,182 @@ static struct kmap {
  { (void*)DEVSPACE, DEVSPACE,      0,         PTE_W}, // more devices
 };
 
+// Like mappages(), but use a 4MB page (PTE_PS in the page
+// directory entry) wherever va and pa are both 4MB aligned and
+// at least 4MB remain.  Only the pieces that don't line up
+// (the low 4MB that holds the read-only kernel text) need
+// page-table pages.  Kernel mappings are global, so loading
+// %cr3 doesn't flush them from the TLB.
+static int
+mapkpages(pde_t *pgdir, uint va, uint size, uint pa, int perm)
+{
+  uint n;
+
+  perm |= PTE_G;
+  while(size > 0){
+    if(va % SPGSIZE == 0 && pa % SPGSIZE == 0 && size >= SPGSIZE){
+      if(pgdir[PDX(va)] & PTE_P)
+        panic("remap");
+      pgdir[PDX(va)] = pa | perm | PTE_P | PTE_PS;
+      n = SPGSIZE;
+    } else {
+      n = SPGROUNDUP(va + 1) - va;  // up to the next 4MB boundary
+      if(n == 0 || n > size)
+        n = size;
+      if(mappages(pgdir, (void*)va, n, pa, perm) < 0)
+        return -1;
+    }
+    va += n;
+    pa += n;
+    size -= n;
+  }
+  return 0;
+}
+
 // Set up kernel part of a page table.
+// The kernel half never changes after kvmalloc(), so every pgdir
+// just points its kernel PDEs at kpgdir's 4MB pages and page
+// tables; only the pgdir page itself is new.
 pde_t*
 setupkvm(void)
 {
   pde_t *pgdir;
-  struct kmap *k;
 
   if((pgdir = (pde_t*)kalloc()) == 0)
     return 0;
-  memset(pgdir, 0, PGSIZE);
-  if (P2V(PHYSTOP) > (void*)DEVSPACE)
-    panic("PHYSTOP too high");
-  for(k = kmap; k < &kmap[NELEM(kmap)]; k++)
-    if(mappages(pgdir, k->virt, k->phys_end - k->phys_start,
-                (uint)k->phys_start, k->perm) < 0)
-      return 0;
+  memset(pgdir, 0, PDX(KERNBASE) * sizeof(pde_t));
+  memmove(&pgdir[PDX(KERNBASE)], &kpgdir[PDX(KERNBASE)],
+          (NPDENTRIES - PDX(KERNBASE)) * sizeof(pde_t));
   return pgdir;
 }
 
 // Allocate one page table for the machine for the kernel address
-// space for scheduler processes.
+// space for scheduler processes.  Its kernel page tables are the
+// ones shared by every other pgdir.
 void
 kvmalloc(void)
 {
-  kpgdir = setupkvm();
+  struct kmap *k;
+
+  initlock(&deadvm.lock, "deadvm");
+  if((kpgdir = (pde_t*)kalloc()) == 0)
+    panic("kvmalloc");
+  memset(kpgdir, 0, PGSIZE);
+  if (P2V(PHYSTOP) > (void*)DEVSPACE)
+    panic("PHYSTOP too high");
+  for(k = kmap; k < &kmap[NELEM(kmap)]; k++)
+    if(mapkpages(kpgdir, (uint)k->virt, k->phys_end - k->phys_start,
+                 (uint)k->phys_start, k->perm) < 0)
+      panic("kvmalloc");
   switchkvm();
 }
 
 // Switch h/w page table register to the kernel-only page table,
-// for when no process is running.
+// for when no process is running.  Used while a CPU starts up,
+// before seginit(); the scheduler keeps the last pgdir loaded.
 void
 switchkvm(void)
 {
   lcr3(V2P(kpgdir));   // switch to the kernel page table
 }
 
+// Is pgdir loaded on any CPU?  Caller must hold deadvm.lock.
+static int
+pgdirloaded(pde_t *pgdir)
+{
+  struct cpu *c;
+
+  for(c = cpus; c < &cpus[ncpu]; c++)
+    if(c->pgdir == pgdir)
+      return 1;
+  return 0;
+}
+
+// Load pgdir into %cr3 unless it is loaded already, and free
+// the pgdir we switched away from if freevm() parked it.
+// Caller must have interrupts off.
+static void
+loadpgdir(pde_t *pgdir)
+{
+  pde_t *old;
+  int i;
+
+  if(cpu->pgdir == pgdir)
+    return;
+  acquire(&deadvm.lock);
+  old = cpu->pgdir;
+  lcr3(V2P(pgdir));
+  cpu->pgdir = pgdir;
+  for(i = 0; i < NCPU; i++){
+    if(deadvm.pgdir[i] == old && !pgdirloaded(old)){
+      deadvm.pgdir[i] = 0;
+      kfree((char*)old);
+    }
+  }
+  release(&deadvm.lock);
+}
+
+// Make every CPU that has pgdir loaded drop its user TLB
+// entries, after the caller has cleared some of its PTEs.
+// Waits until they all have.  Caller must not hold a lock that
+// another CPU could be spinning on with interrupts off.
+void
+tlbshootdown(pde_t *pgdir)
+{
+  struct cpu *c;
+  uint gen[NCPU];
+  int i, n;
+
+  pushcli();
+  if(cpu->pgdir == pgdir)
+    lcr3(V2P(pgdir));  // global kernel entries survive this
+  n = 0;
+  for(c = cpus; c < &cpus[ncpu]; c++){
+    i = c - cpus;
+    gen[i] = 0;
+    if(c == cpu || c->pgdir != pgdir)
+      continue;
+    gen[i] = __sync_add_and_fetch(&c->tlbreq, 1);
+    lapicipi(c->apicid, T_IRQ0 + IRQ_TLB);
+    n++;
+  }
+  // Wait for the acks.  Another CPU may be waiting on us the
+  // same way, so keep answering our own mailbox meanwhile.
+  while(n > 0){
+    if(cpu->tlbdone != cpu->tlbreq)
+      tlbintr();
+    n = 0;
+    for(c = cpus; c < &cpus[ncpu]; c++)
+      if(gen[c - cpus] != 0 && (int)(c->tlbdone - gen[c - cpus]) < 0)
+        n++;
+  }
+  popcli();
+}
+
+// TLB shootdown IPI from tlbshootdown() on another CPU.
+// Flush this CPU's non-global TLB entries and acknowledge.
+void
+tlbintr(void)
+{
+  uint req;
+
+  req = cpu->tlbreq;
+  lcr3(rcr3());
+  cpu->tlbdone = req;
+}
+
+// Free the pages in b once no CPU can reach them any more.
+static void
+tlbbatchflush(struct tlbbatch *b)
+{
+  int i;
+
+  tlbshootdown(b->pgdir);
+  for(i = 0; i < b->n; i++)
+    kfree(b->page[i]);
+  b->n = 0;
+}
+
 // Switch TSS and h/w page table to correspond to process p.
 void
 switchuvm(struct proc *p)
@@ -181,10 +350,26 @@ switchuvm(struct proc *p)
   // forbids I/O instructions (e.g., inb and outb) from user space
   cpu->ts.iomb = (ushort) 0xFFFF;
   ltr(SEG_TSS << 3);
-  lcr3(V2P(p->pgdir));  // switch to process's address space
+  loadpgdir(p->pgdir);  // switch to process's address space
   popcli();
 }
 
+// Return the kernel address of the user page holding va,
+// looking through 4MB pages, or 0 if va is not mapped.
+static char*
+uvapage(pde_t *pgdir, uint va)
+{
+  pde_t pde;
+  pte_t *pte;
+
+  pde = pgdir[PDX(va)];
+  if((pde & (PTE_P|PTE_PS)) == (PTE_P|PTE_PS))
+    return (char*)P2V(PTE_ADDR(pde)) + (PGROUNDDOWN(va) & (SPGSIZE-1));
+  if((pte = walkpgdir(pgdir, (void*)va, 0)) == 0 || (*pte & PTE_P) == 0)
+    return 0;
+  return (char*)P2V(PTE_ADDR(*pte));
+}
+
 // Load the initcode into address 0 of pgdir.
 // sz must be less than a page.
 void
@@ -205,20 +390,19 @@ inituvm(pde_t *pgdir, char *init, uint sz)
 int
 loaduvm(pde_t *pgdir, char *addr, struct inode *ip, uint offset, uint sz)
 {
-  uint i, pa, n;
-  pte_t *pte;
+  uint i, n;
+  char *mem;
 
   if((uint) addr % PGSIZE != 0)
     panic("loaduvm: addr must be page aligned");
   for(i = 0; i < sz; i += PGSIZE){
-    if((pte = walkpgdir(pgdir, addr+i, 0)) == 0)
+    if((mem = uvapage(pgdir, (uint)addr+i)) == 0)
       panic("loaduvm: address should exist");
-    pa = PTE_ADDR(*pte);
     if(sz - i < PGSIZE)
       n = sz - i;
     else
       n = PGSIZE;
-    if(readi(ip, P2V(pa), offset+i, n) != n)
+    if(readi(ip, mem, offset+i, n) != n)
       return -1;
   }
   return 0;
@@ -239,7 +423,21 @@ allocuvm(pde_t *pgdir, uint oldsz, uint newsz)
 
   a = PGROUNDUP(oldsz);
   for(; a < newsz; a += PGSIZE){
-    mem = kalloc();
+    if(pgdir[PDX(a)] & PTE_PS){
+      // Still mapped by a 4MB page that deallocuvm kept.
+      a = SPGROUNDDOWN(a) + SPGSIZE - PGSIZE;
+      continue;
+    }
+    if(a % SPGSIZE == 0 && newsz - a >= SPGSIZE &&
+       (pgdir[PDX(a)] & PTE_P) == 0 && (mem = ksuperalloc()) != 0){
+      // A whole aligned 4MB chunk: map it with one 4MB page,
+      // which needs no page table and one TLB entry.
+      memset(mem, 0, SPGSIZE);
+      pgdir[PDX(a)] = V2P(mem) | PTE_PS | PTE_P | PTE_W | PTE_U;
+      a += SPGSIZE - PGSIZE;
+      continue;
+    }
+    mem = kallocswap();
     if(mem == 0){
       cprintf("allocuvm out of memory\n");
       deallocuvm(pgdir, newsz, oldsz);
@@ -261,34 +459,85 @@ allocuvm(pde_t *pgdir, uint oldsz, uint newsz)
 // newsz.  oldsz and newsz need not be page-aligned, nor does newsz
 // need to be less than oldsz.  oldsz can be larger than the actual
 // process size.  Returns the new process size.
+// Sibling LWPs on other CPUs may be using pgdir, so the pages are
+// only freed after a TLB shootdown, NTLBBATCH pages at a time.
 int
 deallocuvm(pde_t *pgdir, uint oldsz, uint newsz)
 {
+  struct tlbbatch b;
+
+  b.pgdir = pgdir;
+  b.n = 0;
+  pinuvm();
+  newsz = unmapuvm(pgdir, oldsz, newsz, &b);
+  if(b.n > 0)
+    tlbbatchflush(&b);
+  unpinuvm();
+  return newsz;
+}
+
+// Unmap user pages from newsz up to oldsz, as deallocuvm().
+// With b == 0 the pgdir is not running anywhere and the pages
+// are freed at once; otherwise they are collected in b.
+static int
+unmapuvm(pde_t *pgdir, uint oldsz, uint newsz, struct tlbbatch *b)
+{
+  pde_t *pde;
   pte_t *pte;
-  uint a, pa;
+  uint a, pa, spg;
+  char *v;
 
   if(newsz >= oldsz)
     return oldsz;
 
   a = PGROUNDUP(newsz);
   for(; a  < oldsz; a += PGSIZE){
+    pde = &pgdir[PDX(a)];
+    if((*pde & (PTE_P|PTE_PS)) == (PTE_P|PTE_PS)){
+      spg = SPGROUNDDOWN(a);
+      if(a == spg){
+        v = P2V(PTE_ADDR(*pde));
+        *pde = 0;
+        if(b)
+          tlbbatchflush(b);
+        ksuperfree(v);
+      } else {
+        // newsz ends inside this 4MB page.  Keep it mapped, but
+        // clear the part above newsz so growing again sees zeroes.
+        memset((char*)P2V(PTE_ADDR(*pde)) + (a - spg), 0, spg + SPGSIZE - a);
+      }
+      a = spg + SPGSIZE - PGSIZE;
+      continue;
+    }
     pte = walkpgdir(pgdir, (char*)a, 0);
     if(!pte)
       a = PGADDR(PDX(a) + 1, 0, 0) - PGSIZE;
-    else if((*pte & PTE_P) != 0){
+    else if(*pte & PTE_SWAP){
+      swapfree(PTE_ADDR(*pte) >> PTXSHIFT);
+      *pte = 0;
+    } else if((*pte & PTE_P) != 0){
       pa = PTE_ADDR(*pte);
       if(pa == 0)
         panic("kfree");
-      char *v = P2V(pa);
-      kfree(v);
+      v = P2V(pa);
       *pte = 0;
+      if(b == 0)
+        kfree(v);
+      else {
+        b->page[b->n++] = v;
+        if(b->n == NTLBBATCH)
+          tlbbatchflush(b);
+      }
     }
   }
   return newsz;
 }
 
 // Free a page table and all the physical memory pages
-// in the user part.
+// in the user part.  The kernel part belongs to kpgdir.
+// No process may be running on pgdir any more, but idle CPUs
+// can still have it loaded (see deadvm); they never touch user
+// addresses, so there is no TLB shootdown.
 void
 freevm(pde_t *pgdir)
 {
@@ -299,14 +548,30 @@ freevm(pde_t *pgdir)
 
   if(pgdir == 0)
     panic("freevm: no pgdir");
-  deallocuvm(pgdir, KERNBASE, 0);
-  for(i = 0; i < NPDENTRIES; i++){
-    if(pgdir[i] & PTE_P){
+  unmapuvm(pgdir, KERNBASE, 0, 0);
+  for(i = 0; i < PDX(KERNBASE); i++){
+    if((pgdir[i] & (PTE_P|PTE_PS)) == PTE_P){
       char * v = P2V(PTE_ADDR(pgdir[i]));
       kfree(v);
     }
+    pgdir[i] = 0;
   }
-  kfree((char*)pgdir);
+
+  pushcli();
+  if(cpu->pgdir == pgdir)
+    loadpgdir(kpgdir);
+  acquire(&deadvm.lock);
+  if(pgdirloaded(pgdir)){
+    for(i = 0; i < NCPU; i++)
+      if(deadvm.pgdir[i] == 0)
+        break;
+    if(i == NCPU)
+      panic("freevm: deadvm");
+    deadvm.pgdir[i] = pgdir;
+  } else
+    kfree((char*)pgdir);
+  release(&deadvm.lock);
+  popcli();
 }
 
 // Clear PTE_U on a page. Used to create an inaccessible
@@ -322,6 +587,33 @@ clearpteu(pde_t *pgdir, char *uva)
   *pte &= ~PTE_U;
 }
 
+// Copy the 4MB page at va (aligned) from pgdir into d.  If no 4MB
+// page is free, fall back to copying it into 4KB pages up to sz.
+static int
+copysuper(pde_t *pgdir, pde_t *d, uint va, uint sz)
+{
+  char *src, *mem;
+  uint a, flags;
+
+  src = (char*)P2V(PTE_ADDR(pgdir[PDX(va)]));
+  flags = PTE_FLAGS(pgdir[PDX(va)]);
+  if((mem = ksuperalloc()) != 0){
+    memmove(mem, src, SPGSIZE);
+    d[PDX(va)] = V2P(mem) | flags;
+    return 0;
+  }
+  for(a = va; a < va + SPGSIZE && a < sz; a += PGSIZE){
+    if((mem = kalloc()) == 0)
+      return -1;
+    memmove(mem, src + (a - va), PGSIZE);
+    if(mappages(d, (void*)a, PGSIZE, V2P(mem), flags & ~PTE_PS) < 0){
+      kfree(mem);
+      return -1;
+    }
+  }
+  return 0;
+}
+
 // Given a parent process's page table, create a copy
 // of it for a child.
 // LWP2 - 1.2.2.1 copy two distinguished area in address space
@@ -329,46 +621,67 @@ pde_t*
 copyuvm(pde_t *pgdir, uint sz, uint endofstack)
 {
   pde_t *d;
-  pte_t *pte;
-  uint pa, i, flags;
-  char *mem;
 
   if((d = setupkvm()) == 0)
     return 0;
-  // copy bottom to topofstack
-  for(i = 0; i < sz; i += PGSIZE){
-    if((pte = walkpgdir(pgdir, (void *) i, 0)) == 0)
-      panic("copyuvm: pte should exist");
-    if(!(*pte & PTE_P))
-      panic("copyuvm: page not present");
-    pa = PTE_ADDR(*pte);
-    flags = PTE_FLAGS(*pte);
-    if((mem = kalloc()) == 0)
-      goto bad;
-    memmove(mem, (char*)P2V(pa), PGSIZE);
-    if(mappages(d, (void*)i, PGSIZE, V2P(mem), flags) < 0)
-      goto bad;
+  // copy bottom to topofheap, then the stack area.  Pages that
+  // were never faulted in stay that way in the child.
+  if(copyuvmrange(pgdir, d, 0, PGROUNDUP(sz), 0) < 0 ||
+     copyuvmrange(pgdir, d, endofstack, KERNBASE - PGSIZE, 0) < 0){
+    cprintf("LOG: %d %s fail to copy uvm\n", proc->pid, proc->name);
+    freevm(d);
+    return 0;
   }
+  return d;
+}
+
+// Copy the pages of [start, end) that are present in pgdir into
+// d, or map the very same pages into d if share is set (for
+// MAP_SHARED regions).  Read-only pages (page cache pages, see
+// pcache.c) are always shared, and so are the swap slots of
+// swapped-out pages.  start and end must be page aligned.
+int
+copyuvmrange(pde_t *pgdir, pde_t *d, uint start, uint end, int share)
+{
+  pte_t *pte, *dpte;
+  uint a, pa, flags;
+  char *mem;
 
-  // copy stack area
-  for(i = endofstack; i < KERNBASE - PGSIZE; i += PGSIZE){
-    if((pte = walkpgdir(pgdir, (void *) i, 0)) == 0)
-      panic("copyuvm: pte should exist");
+  for(a = start; a < end; a += PGSIZE){
+    if((pgdir[PDX(a)] & (PTE_P|PTE_PS)) == (PTE_P|PTE_PS)){
+      if(copysuper(pgdir, d, a, end) < 0)
+        return -1;
+      a += SPGSIZE - PGSIZE;
+      continue;
+    }
+    if((pte = walkpgdir(pgdir, (void*)a, 0)) == 0){
+      a = PGADDR(PDX(a) + 1, 0, 0) - PGSIZE;
+      continue;
+    }
+    if(*pte & PTE_SWAP){
+      if((dpte = walkpgdir(d, (void*)a, 1)) == 0)
+        return -1;
+      swapdup(PTE_ADDR(*pte) >> PTXSHIFT);
+      *dpte = *pte;
+      continue;
+    }
     if(!(*pte & PTE_P))
-      panic("copyuvm: page not present");
+      continue;
     pa = PTE_ADDR(*pte);
     flags = PTE_FLAGS(*pte);
-    if((mem = kalloc()) == 0)
-      goto bad;
-    memmove(mem, (char*)P2V(pa), PGSIZE);
-    if(mappages(d, (void*)i, PGSIZE, V2P(mem), flags) < 0)
-      goto bad;
+    if(share || !(flags & PTE_W)){
+      mem = P2V(pa);
+      kref(mem);
+    } else {
+      if((mem = kallocswap()) == 0)
+        return -1;
+      memmove(mem, (char*)P2V(pa), PGSIZE);
+    }
+    if(mappages(d, (void*)a, PGSIZE, V2P(mem), flags) < 0){
+      kfree(mem);
+      return -1;
+    }
   }
-  return d;
-
-bad:
-  cprintf("LOG: %d %s fail to copy uvm\n", proc->pid, proc->name);
-  freevm(d);
   return 0;
 }
 
@@ -379,8 +692,10 @@ uva2ka(pde_t *pgdir, char *uva)
 {
   pte_t *pte;
 
+  if((pgdir[PDX(uva)] & (PTE_P|PTE_PS|PTE_U)) == (PTE_P|PTE_PS|PTE_U))
+    return uvapage(pgdir, (uint)uva);
   pte = walkpgdir(pgdir, uva, 0);
-  if((*pte & PTE_P) == 0)
+  if(pte == 0 || (*pte & PTE_P) == 0)
     return 0;
   if((*pte & PTE_U) == 0)
     return 0;
@@ -388,20 +703,28 @@ uva2ka(pde_t *pgdir, char *uva)
 }
 
 // Copy len bytes from p to user address va in page table pgdir.
-// Most useful when pgdir is not the current page table.
-// uva2ka ensures this only works for PTE_U pages.
+// The current address space is written directly by ucopy(), which
+// takes page faults as a user write would (a read-only page cache
+// page is copied first, a missing page is faulted in).  Any other
+// one, such as exec()'s new one, goes through uva2ka, which ensures
+// this only works for PTE_U pages.
 int
 copyout(pde_t *pgdir, uint va, void *p, uint len)
 {
   char *buf, *pa0;
   uint n, va0;
 
+  if(proc && pgdir == proc->pgdir){
+    if(va >= KERNBASE || len > KERNBASE - va)
+      return -1;
+    return ucopy((void*)va, p, len);
+  }
   buf = (char*)p;
   while(len > 0){
     va0 = (uint)PGROUNDDOWN(va);
     pa0 = uva2ka(pgdir, (char*)va0);
     if(pa0 == 0)
-      return -1;
+      break;
     n = PGSIZE - (va - va0);
     if(n > len)
       n = len;
@@ -410,7 +733,30 @@ copyout(pde_t *pgdir, uint va, void *p, uint len)
     buf += n;
     va = va0 + PGSIZE;
   }
-  return 0;
+  return len > 0 ? -1 : 0;
+}
+
+// Copy len bytes from user address va of the current process
+// to dst.  Returns 0, or -1 if some of it is not mapped.
+int
+copyin(void *dst, uint va, uint len)
+{
+  if(va >= KERNBASE || len > KERNBASE - va)
+    return -1;
+  return ucopy(dst, (void*)va, len);
+}
+
+// Copy the nul-terminated string at user address va of the
+// current process to dst, which holds max bytes.  Returns its
+// length, or -1 if it is too long or not mapped.
+int
+copyinstr(char *dst, uint va, uint max)
+{
+  if(va >= KERNBASE)
+    return -1;
+  if(max > KERNBASE - va)
+    max = KERNBASE - va;
+  return ucopystr(dst, (char*)va, max);
 }
 
 //PAGEBREAK!
@@ -0,0 +1,128 @@
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+
+#define NFORK   500
+#define NEXEC   200
+#define HEAPMB  16            // heap touched by the TLB benchmark
+#define NPASS   20
+
+// time NFORK fork()/exit()/wait() rounds.  Each fork builds a new
+// page directory with setupkvm() and copies the parent into it.
+void
+forkbench(void)
+{
+  int i, pid, start;
+
+  start = uptime();
+  for(i = 0; i < NFORK; i++){
+    pid = fork();
+    if(pid < 0){
+      printf(1, "fork failed at %d\n", i);
+      exit();
+    }
+    if(pid == 0)
+      exit();
+    wait();
+  }
+  printf(1, "fork/exit/wait: %d rounds in %d ticks\n", NFORK, uptime() - start);
+}
+
+// time NEXEC fork()/exec()/exit()/wait() rounds.  exec() builds
+// one more page directory per round.
+void
+execbench(void)
+{
+  char *argv[] = { "vmbench", "nop", 0 };
+  int i, pid, start;
+
+  start = uptime();
+  for(i = 0; i < NEXEC; i++){
+    pid = fork();
+    if(pid < 0){
+      printf(1, "fork failed at %d\n", i);
+      exit();
+    }
+    if(pid == 0){
+      exec("vmbench", argv);
+      printf(1, "exec vmbench failed\n");
+      exit();
+    }
+    wait();
+  }
+  printf(1, "fork/exec/exit/wait: %d rounds in %d ticks\n", NEXEC, uptime() - start);
+}
+
+// free pages used by one forked child while it is alive:
+// its pgdir, page tables, kernel stack and copied user memory.
+void
+pagesbench(void)
+{
+  int fds[2], pid, before, during;
+  char c;
+
+  if(pipe(fds) < 0){
+    printf(1, "pipe failed\n");
+    exit();
+  }
+  before = freemem();
+  pid = fork();
+  if(pid < 0){
+    printf(1, "fork failed\n");
+    exit();
+  }
+  if(pid == 0){
+    read(fds[0], &c, 1);
+    exit();
+  }
+  during = freemem();
+  write(fds[1], "x", 1);
+  wait();
+  close(fds[0]);
+  close(fds[1]);
+  printf(1, "pages per forked process: %d (%d free after exit, %d before)\n",
+         before - during, freemem(), before);
+}
+
+// grow the heap by HEAPMB megabytes and touch one word per page,
+// NPASS times.  Every access lands on a different 4KB page, so with
+// 4KB pages this runs out of TLB reach; aligned 4MB chunks of the
+// heap are mapped with superpages and need one entry per 4MB.
+void
+tlbbench(void)
+{
+  char *p, *q;
+  int i, start;
+  uint sum;
+
+  p = sbrk(HEAPMB << 20);
+  if(p == (char*)-1){
+    printf(1, "sbrk %dMB failed\n", HEAPMB);
+    return;
+  }
+  sum = 0;
+  start = uptime();
+  for(i = 0; i < NPASS; i++){
+    for(q = p; q < p + (HEAPMB << 20); q += 4096){
+      *(uint*)q += i;
+      sum += *(uint*)q;
+    }
+  }
+  printf(1, "page stride over %dMB heap: %d passes in %d ticks (%d)\n",
+         HEAPMB, NPASS, uptime() - start, sum);
+  sbrk(-(HEAPMB << 20));
+}
+
+int
+main(int argc, char *argv[])
+{
+  if(argc > 1 && strcmp(argv[1], "nop") == 0)
+    exit();
+  printf(1, "vmbench starting\n");
+  forkbench();
+  execbench();
+  pagesbench();
+  tlbbench();
+  printf(1, "vmbench done\n");
+  exit();
+}